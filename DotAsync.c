@@ -0,0 +1,279 @@
+/* ======================================================================= */
+/**  "DotAsync.c" -- non-blocking encoding: submit, then poll or callback **/
+/* ======================================================================= */
+
+// DotCodeSubmit() copies the message into a job & pushes it onto one of two
+//  bounded lock-free rings (urgent & normal), never blocking the caller; a
+//  pool of encoder threads pops the urgent ring first, so urgent reprints
+//  overtake any backlog.  Each ring is the classic sequence-numbered MPMC
+//  array queue: a cell's sequence number says whether it's free to fill (=
+//  the push position) or ready to empty (= that position + 1), so pushers &
+//  poppers claim cells with a single compare-and-swap of their position.
+//  Idle threads sleep on a condition, which a push only signals if some
+//  thread is actually asleep.  A job is shared by the caller & the pool,
+//  & freed once both have released it.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define UCHAR unsigned char
+
+struct encodejob {
+    volatile long state;    // DOT_QUEUED etc.
+    volatile long refs;     // 2 until the caller & the pool are done with it
+    inputs in;              // (a copy of the message)
+    options opt;
+    long long deadline;
+    encodedone done;
+    void *user;
+    output out;
+    int nbytes;
+};
+
+typedef struct {
+    volatile long seq;
+    encodejob *job;
+} cell;
+
+typedef struct {
+    cell *cells;
+    long mask;              // # of cells - 1 (a power of 2)
+    volatile long head;     // the next push position...
+    volatile long tail;     // ... & the next pop position
+} ring;
+
+typedef struct {
+    encodequeue *q;
+    dcthread thread;
+    dotmap map;             // the placement map of the last size encoded
+} encoder;
+
+struct encodequeue {
+    ring rings[2];          // [0] urgent, [1] normal
+    volatile long sleepers; // # of threads waiting for work
+    dcmutex lock;           // guards "stop" & the sleep
+    dccond cond;
+    int stop;
+    int nthreads;
+    encoder *threads;
+};
+
+/* ======================================================================= */
+/* *********************      LOCK-FREE RINGS      ********************** */
+/* ======================================================================= */
+static int RingInit (ring *r, int depth)
+{
+    long i, n = 2;
+    while (n < depth) n <<= 1;
+    r->cells = (cell*)malloc(sizeof(cell) * n);
+    if (!r->cells) return (-1);
+    for (i=0; i<n; i++) r->cells[i].seq = i;
+    r->mask = n-1;
+    r->head = r->tail = 0;
+    return (0);
+}
+
+static int Push (ring *r, encodejob *job)
+{
+    long pos = AtomicLoad(&r->head), dif;
+    cell *c;
+    while (1) {
+        c = r->cells + (pos & r->mask);
+        dif = (long)((unsigned long)AtomicLoad(&c->seq) - (unsigned long)pos);
+        if (dif == 0) {
+            if (AtomicSwap(&r->head,pos,pos+1)) break;
+        }
+        else if (dif < 0) return (-1);     // full
+        pos = AtomicLoad(&r->head);
+    }
+    c->job = job;
+    AtomicStore(&c->seq,pos+1);
+    return (0);
+}
+
+static encodejob *Pop (ring *r)
+{
+    long pos = AtomicLoad(&r->tail), dif;
+    encodejob *job;
+    cell *c;
+    while (1) {
+        c = r->cells + (pos & r->mask);
+        dif = (long)((unsigned long)AtomicLoad(&c->seq) - (unsigned long)(pos+1));
+        if (dif == 0) {
+            if (AtomicSwap(&r->tail,pos,pos+1)) break;
+        }
+        else if (dif < 0) return (NULL);   // empty
+        pos = AtomicLoad(&r->tail);
+    }
+    job = c->job;
+    AtomicStore(&c->seq,pos + r->mask+1);
+    return (job);
+}
+
+static encodejob *NextJob (encodequeue *q)
+{
+    encodejob *job = Pop(q->rings);
+    return ((job)? job : Pop(q->rings+1));
+}
+
+/* ======================================================================= */
+/* *********************      ENCODER THREADS      ********************** */
+/* ======================================================================= */
+static void ReleaseJob (encodejob *job)
+{
+    if (AtomicAdd(&job->refs,-1)) return;
+    free(job->out.bitmap);
+    free(job);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "RunJob(en,job)" encodes one job (unless it's expired) & reports back  */
+/*-------------------------------------------------------------------------*/
+static void RunJob (encoder *en, encodejob *job)
+{
+    inputs *in = &job->in;
+    output *out = &job->out;
+    UCHAR *CW;
+    int nd, state = DOT_FAILED;
+
+    AtomicStore(&job->state,DOT_RUNNING);
+    if ((job->deadline)&&(ClockMs() > job->deadline)) state = DOT_EXPIRED;
+    else if ((CW = (UCHAR*)malloc(sizeof(UCHAR) * (LEN<<4) + 4))) {
+        nd = FindDataWords(MSG,LEN,CW,MessageMode(&job->opt));
+        if ((nd >= 0)&&((job->nbytes = SymbolSize(DotCodeEccWords(nd,job->opt.ecc),HGT,WID,out)) >= 0)&&
+            ((BMAP = (UCHAR*)malloc(sizeof(UCHAR) * job->nbytes)))&&
+            (!EncodeSymbol(&en->map,out,CW,nd,job->opt.topmsk,0,job->opt.fast))) state = DOT_DONE;
+        free(CW);
+    }
+    AtomicStore(&job->state,state);
+    if (job->done) job->done(job->user,job);
+    ReleaseJob(job);
+}
+
+static void EncoderThread (void *arg)
+{
+    encoder *en = (encoder*)arg;
+    encodequeue *q = en->q;
+    encodejob *job;
+
+    while (1) {
+        if (!(job = NextJob(q))) {
+            // (a pusher that missed this sleeper finds its count raised)
+            MutexLock(&q->lock);
+            AtomicAdd(&q->sleepers,1);
+            while ((!(job = NextJob(q)))&&(!q->stop)) CondWait(&q->cond,&q->lock);
+            AtomicAdd(&q->sleepers,-1);
+            MutexUnlock(&q->lock);
+            if (!job) break;    // stopped, & nothing left queued
+        }
+        RunJob(en,job);
+    }
+}
+
+/* ======================================================================= */
+/* ***********************      ASYNC API      ************************** */
+/* ======================================================================= */
+
+encodequeue *DotCodeStartQueue (int threads, int depth)
+{
+    encodequeue *q = (encodequeue*)calloc(1,sizeof(encodequeue));
+    int i;
+
+    if (threads < 1) threads = CpuCount();
+    if (!q) return (NULL);
+    q->threads = (encoder*)calloc(threads,sizeof(encoder));
+    if ((!q->threads)||(RingInit(q->rings,depth))||(RingInit(q->rings+1,depth))) {
+        free(q->rings[0].cells);
+        free(q->rings[1].cells);
+        free(q->threads);
+        free(q);
+        return (NULL);
+    }
+    MutexInit(&q->lock);
+    CondInit(&q->cond);
+    for (i=0; i<threads; i++) {
+        q->threads[i].q = q;
+        if (ThreadStart(&q->threads[i].thread,EncoderThread,q->threads+i)) break;
+    }
+    q->nthreads = i;
+    if (!i) {
+        DotCodeStopQueue(q);
+        return (NULL);
+    }
+    return (q);
+}
+
+void DotCodeStopQueue (encodequeue *q)
+{
+    int i;
+    MutexLock(&q->lock);
+    q->stop = 1;
+    CondWake(&q->cond);
+    MutexUnlock(&q->lock);
+    for (i=0; i<q->nthreads; i++) {
+        ThreadJoin(q->threads[i].thread);
+        FreeDotMap(&q->threads[i].map);
+    }
+    CondFree(&q->cond);
+    MutexFree(&q->lock);
+    free(q->rings[0].cells);
+    free(q->rings[1].cells);
+    free(q->threads);
+    free(q);
+}
+
+encodejob *DotCodeSubmit (encodequeue *q, inputs *in, options *opt, int priority,
+                          long long deadline, encodedone done, void *user)
+{
+    encodejob *job = (encodejob*)calloc(1,sizeof(encodejob) + LEN + 1);
+
+    if (!job) return (NULL);
+    job->state = DOT_QUEUED;
+    job->refs = 2;
+    job->in = *in;
+    job->in.msg = (UCHAR*)(job+1);
+    memcpy(job->in.msg,MSG,LEN);
+    job->opt = *opt;
+    SetLayout(&job->out,opt);
+    job->deadline = deadline;
+    job->done = done;
+    job->user = user;
+    job->nbytes = -1;
+
+    if (Push(q->rings + ((priority > 0)? 0:1),job)) {
+        free(job);      // (that ring is full)
+        return (NULL);
+    }
+    if (AtomicLoad(&q->sleepers)) {
+        MutexLock(&q->lock);
+        CondWake(&q->cond);
+        MutexUnlock(&q->lock);
+    }
+    return (job);
+}
+
+int DotCodeStatus (encodejob *job)
+{
+    return ((int)AtomicLoad(&job->state));
+}
+
+output *DotCodeResult (encodejob *job, int *nbytes)
+{
+    if (AtomicLoad(&job->state) != DOT_DONE) return (NULL);
+    if (nbytes) *nbytes = job->nbytes;
+    return (&job->out);
+}
+
+void DotCodeRelease (encodejob *job)
+{
+    ReleaseJob(job);
+}
+
+long long DotCodeClock (void)
+{
+    return (ClockMs());
+}
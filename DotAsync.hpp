@@ -0,0 +1,65 @@
+/* ======================================================================= */
+/**  "DotAsync.hpp" -- C++20 coroutine awaitable for DotCodeSubmit()      **/
+/* ======================================================================= */
+
+// "co_await dotcode::Encode(q,in,opt)" submits the encode & suspends the
+//  coroutine until the job completes, resuming it -on the encoder thread-
+//  (an event loop should re-post itself from there).  The result is the
+//  finished job (DotCodeStatus() tells how it ended), to be DotCodeRelease()d
+//  as usual, or nullptr if the queue was full.  Builds without C++20
+//  coroutines get nothing from this header.
+
+#ifndef DOTASYNC_HPP
+#define DOTASYNC_HPP
+
+#include "DotEncod.h"
+
+#if (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+
+namespace dotcode {
+
+class EncodeAwaitable {
+public:
+    EncodeAwaitable (encodequeue *q, inputs in, options opt, int priority, long long deadline)
+        : q(q), in(in), opt(opt), priority(priority), deadline(deadline) {}
+
+    bool await_ready () const noexcept { return false; }
+    bool await_suspend (std::coroutine_handle<> h)
+    {
+        waiter = h;
+        // (once submitted, only Resume() may touch this, as it may be gone)
+        return (DotCodeSubmit(q,&in,&opt,priority,deadline,&Resume,this) != nullptr);
+    }
+    encodejob *await_resume () const noexcept { return job; }
+
+private:
+    static void Resume (void *user, encodejob *job)
+    {
+        EncodeAwaitable *self = static_cast<EncodeAwaitable*>(user);
+        self->job = job;
+        self->waiter.resume();
+    }
+
+    encodequeue *q;
+    inputs in;
+    options opt;
+    int priority;
+    long long deadline;
+    encodejob *job = nullptr;
+    std::coroutine_handle<> waiter;
+};
+
+inline EncodeAwaitable Encode (encodequeue *q, inputs in, options opt,
+                               int priority = DOT_NORMAL, long long deadline = 0)
+{
+    return EncodeAwaitable(q,in,opt,priority,deadline);
+}
+
+}   // namespace dotcode
+
+#endif
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 #include <stdio.h>
 
 #include "DotEncod.h"
+#include "DotThrd.h"
 
 #define UCHAR unsigned char
 #define TWIX(a,b,c) (((a)<=(c))&&((c)<=(b)))
@@ -23,23 +24,36 @@
 /*-------------------------------------------------------------------------*/
 void Usage(void)
 {
-    printf("\nCommand line: \"DotCode File [/x# /u# /h# /w# /q# /d# /l /s /p /f]\"\n");
+    printf("\nCommand line: \"DotCode File [/x# /u# /h# /w# /q# /d# /r#-# /j# /k# /o# /l /g /s /p /f[#] /v /c# /z /e]\"\n");
     printf("where: \"File\" is the Input Message file name\n");
     printf("         [alternately, \"/abcde...\" loads Message from the Command line]\n");
     printf("         Note: \"#0\"-\"#3\" invoke <NUL> & FNC1-3 respectively, \"##\" encodes \"#\"\n");
     printf("           -except- \"/l\" invokes Literal encoding instead (no FNCx support!)\n");
+    printf("           -or- \"/g\" takes GS1 element strings, \"(01)...(10)...\"\n");
     printf("       /x# specifies the X-dimension (1 to N pixels, default = 5)\n");
     printf("       /u# specifies a dot Undercut (0 to X-1 pixels, default = 0)\n");
     printf("       /h# specifies symbol Height, and/or...\n");
     printf("       /w# specifies symbol Width (BOTH specify a H/W ratio, default = 2/3)\n");
     // printf("         Note: Height & Width BOTH Negative defines size (possibly illegal!)\n");
     printf("       /q# specifies a quiet zone width (default is 3 dots)\n");
+    printf("       /r#-# encodes a Range of serial numbers appended to the Message\n");
+    printf("         (zero padded to the width of the first, e.g. \"/r000100-000199\")\n");
+    printf("       /j# specifies the # of worker threads for /r (default = all CPUs)\n");
+    printf("       /k# specifies an ECC level, 0-4, each adding ~25%% check words (default = 0)\n");
+    printf("       /o# Optimizes the size within /h by /w (if given) for the (0) fewest dots,\n");
+    printf("         (1) least width, (2) least height, or (3) nearest /h:/w aspect (not with /r)\n");
     // printf("       /d# specifies (1) round dots vs. (0) squares (default is round)\n");
     // printf("       /m# specifies symbol Mask 1-4 (default is Best Mask)\n");
     printf("       /s  Shows encoding details on the screen\n");
     printf("       /p  Plots the symbol on the screen\n");
     printf("       /f  Fast algo=stops at first mask passing the score threshold\n");
-    printf("Output is \"DotCode.bmp\".  [Copyright 2016-2017 AIM TSC]");
+    printf("         (\"/f2\" tries the masks that most often passed first,\n");
+    printf("          & adding 4 scores symbols of 128+ rows by sample)\n");
+    printf("       /v  Verifies the symbol by decoding it back\n");
+    printf("       /c# Compares the encoder with the reference on the Message & # random ones\n");
+    printf("       /z  Outputs a ZPL label (compressed ^GF) instead of a bitmap\n");
+    printf("       /e  Outputs an ESC/POS raster (GS v 0) command instead\n");
+    printf("Output is \"DotCode.bmp\" (\"DotCode<serial>.bmp\" for /r, .zpl or .pos for /z or /e).  [Copyright 2016-2017 AIM TSC]");
 }
 
 /* ======================================================================= */
@@ -66,126 +80,284 @@ void BmpHeader(int xdim, output *out, FILE *f, int qzwid)
 }
 
 /*-------------------------------------------------------------------------*/
-/*      "NextBit(b,*q,f)" adds bit "b" to byte "q", outputting to file "f"  */
+/* BmpImage(im,out,fname) creates BMP file "fname" for the matrix symbol   */
+/* whose bitmap is in "out", imaged as "im" specifies (scaled by "xdim",   */
+/* undercut by "ucut", "dots" true producing round dots, & with a quiet    */
+/* zone "qzwid" dots wide), scanning it up a band of rows at a time        */
 /*-------------------------------------------------------------------------*/
-void NextBit (int obt, int *q, FILE *f)
+#define BMP_BAND 16
+
+static void BmpImage (imaging *im, output *out, const char *fname)
 {
-    *q += *q + (1-obt);
-    if (*q > 255) {
-        fprintf(f,"%c",*q-256);
-        *q = 1;
+    int i, k, r, n, hgt, quiet = im->qzwid * im->xdim, nbytes = DotCodeImage(out,im,NULL,&hgt);
+    UCHAR *rows, *line;
+    dotscan *scan;
+    FILE *ofile;
+
+    if (nbytes < 0) return;
+    rows = (UCHAR*)malloc(sizeof(UCHAR) * nbytes * BMP_BAND);
+    if (!rows) return;
+    if (!(scan = DotCodeScanStart(out,im,1))) {       // Bottom row first!!
+        free(rows);
+        return;
     }
+
+    /*** First open the file and include the BMP header, ***/
+    ofile = fopen(fname,"wb");
+    if (ofile) {
+        BmpHeader(im->xdim,out,ofile,im->qzwid);
+        for (i=hgt-1; (n = DotCodeScanLines(scan,rows,BMP_BAND)) > 0; ) {
+            for (r=0; r<n; r++,i--) {
+                line = rows + r * nbytes;
+                for (k=0; k<nbytes; k++) line[k] = ~line[k];   // (BMP "1"s are white)
+                fwrite(line,sizeof(UCHAR),nbytes,ofile);
+                /*** & finally padding each row to a multiple of 4 bytes! ***/
+                for (k=nbytes; k&3; k++) fputc(((i < quiet)||(i >= hgt-quiet))? 255:0,ofile);
+            }
+        }
+        fclose(ofile);
+    }
+    DotCodeScanStop(scan);
+    free(rows);
 }
 
 /*-------------------------------------------------------------------------*/
-/* BmpImage(xdim,ucut,out,dot,qzwid) creates a BMP file "dotcode.bmp" for  */
-/* the matrix symbol whose bitmap is in "out" scaled by "xdim" & undercut  */
-/* by "ucut".  "dot" true produces round dots, & "qzwid" adds a quiet zone */
+/* SaveImage(format,im,out,name) saves the symbol as "name" plus ".bmp",   */
+/* or as a ZPL label (".zpl") or an ESC/POS raster command (".pos")        */
 /*-------------------------------------------------------------------------*/
-#define BIT(x,y) (BMAP[(x>>3)+(y*((7+NCOL)>>3))]>>(7-(x&0x7)))%0x2
-#define K (k%(NROW+1))
+#define FORMAT_BMP 0
+#define FORMAT_ZPL 1
+#define FORMAT_ESCPOS 2
 
-static void BmpImage (int xdim, int ucut, output *out, int dot, int qzwid)
+static void SaveImage (int format, imaging *im, output *out, const char *name)
 {
-    int i, j, k, l, start, nwords, obt, ebit, sbit, sebit, xdis, ydis, mask, q = 1;
+    char fname[64];
+    UCHAR *cmd;
     FILE *ofile;
+    int n;
 
-    /*** First open the file and include the BMP header, ***/
-    ofile = fopen("DotCode.bmp","wb");
-    BmpHeader(xdim,out,ofile,qzwid);
-    /*** then point "start" at the start of one row at a time ***/
-    nwords = (7+NCOL)/8;
-
-    for (i=qzwid*xdim*(((((NCOL+(qzwid<<1))*xdim)+31)>>5)<<2); i>0; i--) fprintf(ofile,"%c",255);   // Bottom quiet zone
-
-    for (i=NROW-1; i>=0; i--) {        // Bottom row first!!
-        start = i * nwords;
-        /*** ... and output this row "xdim" times ***/
-        for (j=0; j<xdim; j++) {
-
-            for (k=qzwid*xdim; k; k--) NextBit(0,&q,ofile); // Left quiet zone
-
-            ydis = (j<<1) - (xdim-ucut-1);
-            if (ydis < 0) ydis = -ydis;
-            for (k=0; k<NCOL; k++) {
-                /*** fetching each module state in succession ***/
-                obt = (BMAP[start + k/8]>>(7-(k%8)))%2;
-                if (k < NCOL-1) ebit = (BMAP[start + (k+1)/8]>>(7-((k+1)%8)))%2;
-                else ebit = 0;
-                if (i > 0) {
-                    sbit = (BMAP[start - nwords + k/8]>>(7-(k%8)))%2;
-                    if (k < NCOL-1) sebit = (BMAP[start - nwords + (k+1)/8]>>(7-((k+1)%8)))%2;
-                    else sebit = 0;
-                }
-                else sbit = sebit = 0;
+    if (format == FORMAT_BMP) {
+        sprintf(fname,"%s.bmp",name);
+        BmpImage(im,out,fname);
+        return;
+    }
+    n = (format == FORMAT_ZPL)? DotCodeZPL(out,im,1,NULL) : DotCodeEscPos(out,im,NULL);
+    if ((n < 0)||(!(cmd = (UCHAR*)malloc(sizeof(UCHAR) * n)))) return;
+    if (format == FORMAT_ZPL) DotCodeZPL(out,im,1,(char*)cmd);
+    else DotCodeEscPos(out,im,cmd);
+
+    sprintf(fname,"%s.%s",name,(format == FORMAT_ZPL)? "zpl":"pos");
+    ofile = fopen(fname,"wb");
+    if (ofile) {
+        if (format == FORMAT_ZPL) fprintf(ofile,"^XA^FO0,0");
+        fwrite(cmd,sizeof(UCHAR),n,ofile);
+        if (format == FORMAT_ZPL) fprintf(ofile,"^XZ\n");
+        fclose(ofile);
+    }
+    free(cmd);
+}
 
-                /*** ... and output it "xdim" times, ***/
-                for (l=0; l<xdim; l++) {
-                    xdis = (l<<1) - (xdim-ucut-1);
-                    if (xdis < 0) xdis = -xdis;
+/*-------------------------------------------------------------------------*/
+/*          "PlotSymbol()" displays the bitmap for a DotCode symbol        */
+/*          The "plot" is truncated at column 80 if the code is wider      */
+/*-------------------------------------------------------------------------*/
+static void PlotSymbol (output *out)
+{
+    int i, j;
+    for (i=0; i<NROW; i++) {
+        for (j=0; j<NCOL; j++) {
+            if (j < 80) printf((DotCodeDot(out,j,i)) ? "O" : " ");
+        }
+        if (j < 80) printf("|\n");
+    }
+    for (j=0; j<NCOL; j++)
+        printf("+");
+    printf("+\n");
+}
 
-                    if (obt) {
-                        if (dot) {
-                            if ((l >= xdim-ucut) || (j >= xdim-ucut)) obt = 0;
-                        }
-                        else {
-                            /*** (This fancy conditional preserves the bullseye intact!) ***/
-                            if (
-                                ((l >= xdim-ucut)&&(!ebit))
-                                ||((j >= xdim-ucut)&&(!sbit))
-                                ||((l >= xdim-ucut)&&(j >= xdim-ucut)&&(!sebit))
-                            ) obt = 0;
-                        }
-                    }
+/*-------------------------------------------------------------------------*/
+/*  "SaveSerial()" is the DotCodeRange() sink, saving each serial's image   */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    imaging im;
+    int format, digits;
+} imageparms;
 
-                    mask = ((dot)&&((xdis+ydis) > (xdim-ucut)*4/3))? 0:obt;
+static int SaveSerial (void *user, long serial, output *out, int nbytes)
+{
+    imageparms *p = (imageparms*)user;
+    char name[48];
+    if (nbytes <= 0) return (1);    // (no bitmap: stop the run)
+    sprintf(name,"DotCode%0*ld",p->digits,serial);
+    SaveImage(p->format,&p->im,out,name);
+    return (0);
+}
 
-                    NextBit(mask,&q,ofile);
-                }
-            }
+/*-------------------------------------------------------------------------*/
+/* SizeGoal(in,opt,goal) sets the "in" size by DotCodeOptimize(), its     */
+/* "hgt" & "wid" being the largest allowed (& if both, the aspect wanted), */
+/* returning 0 if no size meets the goal                                   */
+/*-------------------------------------------------------------------------*/
+static int SizeGoal (inputs *in, options *opt, int goal)
+{
+    sizegoal g;
+    int rows, cols;
+    g.maxhgt = in->hgt;
+    g.maxwid = in->wid;
+    g.goal = goal;
+    g.hgt = (in->hgt && in->wid)? in->hgt : 2;
+    g.wid = (in->hgt && in->wid)? in->wid : 3;
+    if (DotCodeOptimize(DotCodeEccWords(DotCodeWordsOptions(in,opt),opt->ecc),&g,&rows,&cols) < 0) return (0);
+    in->hgt = -rows;
+    in->wid = -cols;
+    return (1);
+}
 
-            for (k=qzwid*xdim; k; k--) NextBit(0,&q,ofile); // Right quiet zone
+/*-------------------------------------------------------------------------*/
+/* SameGs1(msg,len,back,n) returns 1 if the decoded "back" is the GS1 "msg" */
+/* as encoded: FNC1 first, & the AIs & data with their "()"s dropped, any  */
+/* FNC1 separators aside                                                   */
+/*-------------------------------------------------------------------------*/
+static int SameGs1 (const UCHAR *msg, int len, const UCHAR *back, int n)
+{
+    int i = 0, k = 2, inai = 0;
+    if ((n < 2)||(back[0] != '#')||(back[1] != '1')) return (0);
+    for (;;) {
+        if ((i < len)&&((msg[i] == '(')||((msg[i] == ')')&&(inai)))) inai = (msg[i++] == '(');
+        else if ((k+1 < n)&&(back[k] == '#')&&(back[k+1] == '1')) k += 2;
+        else if ((i >= len)||(k >= n)) break;
+        else if (msg[i++] != back[k++]) return (0);
+    }
+    return ((i >= len)&&(k >= n));
+}
 
-            /*** finally padding each row's final byte with "0"s ***/
-            while (q != 1) NextBit(0,&q,ofile);
-            /*** & finally padding each row to a multiple of 4 bytes! ***/
-            k = ((NCOL+(qzwid<<1))*xdim + 7)/8;
-            k %= 4;
-            if (k) {
-                for (; k<4; k++) fprintf(ofile,"%c",0);
-            }
+/*-------------------------------------------------------------------------*/
+/* RandomGs1(msg,len) makes up GS1 element strings, about "len" long, of   */
+/* the commonest AIs, mostly numeric                                       */
+/*-------------------------------------------------------------------------*/
+static int RandomGs1 (char *msg, int len)
+{
+    static const char *ai[6] = { "01", "17", "3103", "00", "10", "21" };
+    static const int fixed[6] = { 14, 6, 6, 18, 0, 0 };
+    int k, j, n = 0, digits = rand() & 1;
+    do {
+        k = rand() % 6;
+        n += sprintf(msg+n,"(%s)",ai[k]);
+        for (j=(fixed[k])? fixed[k] : 1 + rand() % 20; j; j--) {
+            msg[n++] = (char)(((digits)||(fixed[k]))? '0' + rand() % 10 : 'A' + rand() % 26);
         }
-
     }
-
-    for (i=qzwid*xdim*(((((NCOL+(qzwid<<1))*xdim)+31)>>5)<<2); i>0; i--) fprintf(ofile,"%c",255);   // Top quiet zone
-
-    fclose(ofile);
+    while (n < len);
+    return (n);
 }
 
 /*-------------------------------------------------------------------------*/
-/*          "PlotSymbol()" displays the bitmap for a DotCode symbol        */
-/*          The "plot" is truncated at column 80 if the code is wider      */
+/* CheckDots(in,opt,scan) lists the dots of the message's symbol along     */
+/* "scan", & returns 1 if they're exactly its printed dots, line by line   */
+/* in firing order                                                         */
 /*-------------------------------------------------------------------------*/
-static void PlotSymbol (output *out)
+static int CheckDots (inputs *in, options *opt, int scan)
 {
-    int i, j, k, c, b;
-    for (i=k=0; i<NROW; i++) {
-        for (j=0; j<NCOL; j++) {
-            if (!(j%8)) {
-                c = BMAP[k++];
-                b = 128;
+    options o = *opt;
+    output out;
+    dotlist list;
+    int i, j, k, m = 0, n, nlines, npos, ok = 0;
+
+    if ((n = DotCodeEncodeOptions(in,&out,&o,0,0)) < 0) return (1);
+    k = (out.rows * out.cols)>>1;
+    out.bitmap = (UCHAR*)malloc(sizeof(UCHAR) * n);
+    list.x = (unsigned short*)malloc(sizeof(unsigned short) * k);
+    list.y = (unsigned short*)malloc(sizeof(unsigned short) * k);
+    list.line = (int*)malloc(sizeof(int) * (out.rows + out.cols + 1));
+    list.scan = scan;
+    o.dots = &list;
+    if ((out.bitmap)&&(list.x)&&(list.y)&&(list.line)&&(DotCodeEncodeOptions(in,&out,&o,1,0) == n)) {
+        nlines = (scan & DOT_SCAN_Y)? out.rows : out.cols;
+        npos = (scan & DOT_SCAN_Y)? out.cols : out.rows;
+        ok = 1;
+        for (i=0; (ok)&&(i<nlines); i++) {
+            int L = (scan & DOT_SCAN_REVERSE)? nlines-1-i : i;
+            if (list.line[i] != m) ok = 0;
+            for (j=0; (ok)&&(j<npos); j++) {
+                int x = (scan & DOT_SCAN_Y)? j : L, y = (scan & DOT_SCAN_Y)? L : j;
+                if (!DotCodeDot(&out,x,y)) continue;
+                if ((m >= list.ndots)||(list.x[m] != x)||(list.y[m] != y)) ok = 0;
+                m++;
             }
-            if (j < 80) {
-                printf((c&b) ? "O" : " ");
-                b >>= 1;
+        }
+        if ((m != list.ndots)||(list.line[nlines] != m)) ok = 0;
+    }
+    free(out.bitmap);
+    free(list.x);
+    free(list.y);
+    free(list.line);
+    return (ok);
+}
+
+/*-------------------------------------------------------------------------*/
+/* CompareEncoders(in,opt,n) runs the message, & "n" random ones, through  */
+/* both the optimized & the reference encoders, reporting any differences  */
+/* & the time each spent in each stage, & returns 1 if none differed (& no */
+/* malformed "#x" sequence was accepted, & the dot lists all check out)    */
+/*-------------------------------------------------------------------------*/
+static int CompareEncoders (inputs *in, options *opt, int n)
+{
+    static const char *stage[DOT_STAGES] = { "data", "R-S", "fill", "score" };
+    static const char *malformed[] = { "#", "AB#", "AB##C#", "AB#x", "#4", "A#B" };
+    diffreport rep;
+    inputs rnd;
+    output out;
+    UCHAR msg[402];
+    int i, k, len, kind, accepted = 0, listed = 1;
+    long long opt_ns = 0, ref_ns = 0;
+
+    if ((!opt->literal)&&(!opt->gs1)) {
+        for (i=0; i<(int)(sizeof(malformed)/sizeof(malformed[0])); i++) {
+            rnd.msg = (UCHAR*)malformed[i];
+            rnd.msglen = strlen(malformed[i]);
+            rnd.hgt = rnd.wid = 0;
+            if ((DotCodeEncode(&rnd,&out,0,-1,0,0,0) >= 0)||(DotCodeWords(&rnd,0) >= 0)) {
+                printf("Malformed message \"%s\" was accepted!\n",malformed[i]);
+                accepted++;
             }
         }
-        if (j < 80) printf("|\n");
     }
-    for (j=0; j<NCOL; j++)
-        printf("+");
-    printf("+\n");
+    memset(&rep,0,sizeof(diffreport));
+    if (DotCodeCompare(in,opt,&rep) < 0) printf("\nThe Message can't be encoded!\n");
+    srand(1);
+    for (i=0; i<n; i++) {
+        // digits, text, binary, or a mixture, in symbols of any shape
+        len = 1 + rand() % 200;
+        kind = rand() % 4;
+        if (opt->gs1) k = RandomGs1((char*)msg,len);
+        else for (k=0; k<len; k++) {
+            if ((kind == 0)||((kind == 3)&&(rand() & 1))) msg[k] = '0' + rand() % 10;
+            else if (kind == 2) msg[k] = (UCHAR)(rand() & 0xff);
+            else msg[k] = 32 + rand() % 95;
+            if ((msg[k] == '#')&&(!opt->literal)) msg[++k] = '#';
+        }
+        rnd.msg = msg;
+        rnd.msglen = k;
+        rnd.hgt = (rand() & 1)? 5 + rand() % 30 : 0;
+        rnd.wid = 0;
+        DotCodeCompare(&rnd,opt,&rep);
+        if (!CheckDots(&rnd,opt,i & (DOT_SCAN_Y|DOT_SCAN_REVERSE))) listed = 0;
+    }
+    if (!CheckDots(in,opt,DOT_SCAN_X|DOT_SCAN_REVERSE)) listed = 0;
+    if (!CheckDots(in,opt,DOT_SCAN_Y|DOT_SCAN_REVERSE)) listed = 0;
+    if (!listed) printf("A dot list didn't match its symbol!\n");
+
+    printf("Compared %ld symbols: %ld differed (%ld in codewords, %ld in mask, %ld in bitmap)\n",
+           rep.symbols,rep.differ,rep.words,rep.masks,rep.bitmaps);
+    printf("  stage      reference     optimized   speedup\n");
+    for (i=0; i<DOT_STAGES; i++) {
+        printf("  %-6s %11.3fms %11.3fms %8.2fx\n",stage[i],rep.refns[i]/1e6,rep.optns[i]/1e6,
+               (rep.optns[i])? (double)rep.refns[i]/rep.optns[i] : 0.0);
+        ref_ns += rep.refns[i];
+        opt_ns += rep.optns[i];
+    }
+    printf("  %-6s %11.3fms %11.3fms %8.2fx\n","total",ref_ns/1e6,opt_ns/1e6,(opt_ns)? (double)ref_ns/opt_ns : 0.0);
+    return ((!rep.differ)&&(!accepted)&&(listed));
 }
 
 /* ======================================================================== */
@@ -194,14 +366,18 @@ static void PlotSymbol (output *out)
 
 int main (int argc, char *argv[])
 {
-    int i, ucut, xdim, hgt, wid, dots, lit, msk, qz, show, plot, fast, ok;
+    int i, ucut, xdim, hgt, wid, dots, lit, gs1, msk, qz, show, plot, fast, verify, ok, digits, jobs, format, compare, ecc, goal;
+    long first, last;
     UCHAR fname[250];
 
     // Default all of the local and input parameters:
-    ucut = show = plot = hgt = wid = lit = fast = 0;
+    ucut = show = plot = hgt = wid = lit = gs1 = fast = verify = digits = ecc = 0;
+    format = FORMAT_BMP;
+    first = last = compare = -1;
+    jobs = CpuCount();
     xdim = 5;
     qz = 3;
-    msk = -1;
+    msk = goal = -1;
     dots = ok = 1;
 
     // Then parse the command line for all arguments:
@@ -236,6 +412,10 @@ int main (int argc, char *argv[])
             case 'q':
                 qz = atoi(argv[i]+2);
                 break;
+            case 'O':
+            case 'o':
+                goal = atoi(argv[i]+2);
+                break;
             case 'D':
             case 'd':
                 dots = atoi(argv[i]+2);
@@ -244,6 +424,10 @@ int main (int argc, char *argv[])
             case 'l':
                 lit = 1;
                 break;
+            case 'G':
+            case 'g':
+                gs1 = 1;
+                break;
             case 'S':
             case 's':
                 show = 1;
@@ -254,7 +438,37 @@ int main (int argc, char *argv[])
                 break;
             case 'f':
             case 'F':
-                fast = 1;
+                fast = (argv[i][2])? atoi(argv[i]+2) : DOT_FAST_FIXED;
+                break;
+            case 'V':
+            case 'v':
+                verify = 1;
+                break;
+            case 'R':
+            case 'r':
+                digits = strspn(argv[i]+2,"0123456789");
+                first = atol(argv[i]+2);
+                if (argv[i][2+digits] == '-') last = atol(argv[i]+3+digits);
+                break;
+            case 'J':
+            case 'j':
+                jobs = atoi(argv[i]+2);
+                break;
+            case 'K':
+            case 'k':
+                ecc = atoi(argv[i]+2);
+                break;
+            case 'C':
+            case 'c':
+                compare = atoi(argv[i]+2);
+                break;
+            case 'Z':
+            case 'z':
+                format = FORMAT_ZPL;
+                break;
+            case 'E':
+            case 'e':
+                format = FORMAT_ESCPOS;
                 break;
             default:
                 printf("\nUnrecognized Argument!\n");
@@ -273,7 +487,11 @@ int main (int argc, char *argv[])
             printf("\nUnachieveable Undercut!\n");
             ok = 0;
         }
-        if ((!wid)&&(hgt)&&(hgt < 5)) {
+        if ((goal >= 0)&&((goal > DOT_SIZE_ASPECT)||(hgt < 0)||(wid < 0)||(digits))) {
+            printf("\nIllegal Size Goal!\n");
+            ok = 0;
+        }
+        else if ((!wid)&&(hgt)&&(hgt < 5)) {
             printf("\nSymbol Height too Low!\n");
             ok = 0;
         }
@@ -285,13 +503,24 @@ int main (int argc, char *argv[])
             printf("\nIllegal Mask Value!\n");
             ok = 0;
         }
+        if (!TWIX(0,DOT_ECC_LEVELS-1,ecc)) {
+            printf("\nIllegal ECC Level!\n");
+            ok = 0;
+        }
+        if ((digits)&&((last < first)||(digits > 18))) {
+            printf("\nIllegal Serial Range!\n");
+            ok = 0;
+        }
     }
 
     if (ok) {
         // OK so far?... then accept the data message:
         inputs in;
+        options opt;
         output OUT, *out = &OUT;
+        imaging im;
         UCHAR msg[4001];
+        memset(&OUT,0,sizeof(output));
         if ((*fname == '-')||(*fname == '/')) strcpy(msg,fname+1);
         else {
             FILE *f = fopen(fname,"rb");
@@ -312,6 +541,12 @@ int main (int argc, char *argv[])
             in.msglen = strlen(msg);
             in.hgt = hgt;
             in.wid = wid;
+            DotCodeDefaults(&opt);
+            opt.literal = lit;
+            opt.gs1 = gs1;
+            opt.topmsk = msk;
+            opt.fast = fast;
+            opt.ecc = ecc;
 
             if (show) {
                 printf("Input Data: ");
@@ -319,17 +554,61 @@ int main (int argc, char *argv[])
                 printf("\n");
             }
 
-            // & if so, go find out how big this symbol must be
-            i = DotCodeEncode(&in,&OUT,lit,msk,0,0, 1);
-
-            if (i >= 0) {
+            if ((goal >= 0)&&(!SizeGoal(&in,&opt,goal))) {
+                printf("\nNo Symbol Size meets the Goal!\n");
+                ok = 0;
+            }
+            else if (compare >= 0) {
+                // the optimized encoder checked against the reference
+                if (!CompareEncoders(&in,&opt,compare)) ok = 0;
+            }
+            else if (digits) {
+                // a serial number range, the message being the template
+                imageparms parms;
+                parms.im.xdim = xdim;
+                parms.im.ucut = ucut;
+                parms.im.dots = dots;
+                parms.im.qzwid = qz;
+                parms.format = format;
+                parms.digits = digits;
+                i = DotCodeRange(&in,in.msglen,digits,first,last,&opt,jobs,SaveSerial,&parms);
+                if (i < 0) {
+                    printf("\nEncoding failure! - Check input parameters\n");
+                    ok = 0;
+                }
+                else if (show) printf("%d symbols encoded\n",i);
+            }
+            // or if not, go find out how big this symbol must be
+            else if ((i = DotCodeEncodeOptions(&in,&OUT,&opt,0,0)) >= 0) {
                 BMAP = (UCHAR*)malloc(sizeof(UCHAR) * i);
                 if (BMAP) {
-                    DotCodeEncode(&in,&OUT,lit,msk,1,show, fast);
+                    DotCodeEncodeOptions(&in,&OUT,&opt,1,show);
+                    if (show) {
+                        printf("Capacity by ECC level:");
+                        for (i=0; i<DOT_ECC_LEVELS; i++) printf("  %d: %d",i,DotCodeEccCapacity(NROW,NCOL,i));
+                        printf(" data words\n");
+                    }
 
                     if (plot) PlotSymbol(out);
 
-                    BmpImage(xdim,ucut,out,dots,qz);
+                    if (verify) {
+                        UCHAR *back = (UCHAR*)malloc(sizeof(UCHAR) * ((in.msglen<<1) + 16));
+                        decodeinfo info;
+                        int n = (back)? DotCodeDecode(out,back,(in.msglen<<1) + 16,(gs1)? 0:lit,&info) : -1;
+                        if ((gs1)? ((n >= 0)&&(SameGs1(msg,in.msglen,back,n))) : ((n == in.msglen)&&(!memcmp(back,msg,n))))
+                            printf("Verified (mask %d, %d erasures, %d errors)\n",info.mask,info.erasures,info.errors);
+                        else {
+                            printf("\nVerification FAILED!\n");
+                            ok = 0;
+                        }
+                        free(back);
+                    }
+
+                    im.xdim = xdim;
+                    im.ucut = ucut;
+                    im.dots = dots;
+                    im.qzwid = qz;
+                    SaveImage(format,&im,out,"DotCode");
 
                     free (BMAP);
 
@@ -0,0 +1,159 @@
+/* ======================================================================= */
+/**  "DotCode.hpp" -- C++17 encoder & move-only symbols, pmr allocated    **/
+/* ======================================================================= */
+
+// "dotcode::Encoder enc(opt,&arena); dotcode::Symbol s = enc.Encode(msg);"
+//  encodes "msg" (a string_view, or a span of bytes in C++20) in place, the
+//  encoder's scratch memory & the symbol's bitmap all coming from "arena"
+//  (any std::pmr::memory_resource, the default resource if none is given).
+//  A Symbol owns its bitmap & can only be moved, which never copies it, so
+//  symbols pass through queues & containers freely; one that failed to
+//  encode is empty (false).  Get() hands the "output" to the C API, for
+//  imaging, printing or decoding.  The Symbol must not outlive its
+//  resource.  Builds without C++17 get nothing from this header.
+
+#ifndef DOTCODE_HPP
+#define DOTCODE_HPP
+
+#include "DotEncod.h"
+
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <climits>
+#include <cstddef>
+#include <memory_resource>
+#include <string_view>
+#include <utility>
+#if __has_include(<span>) && (__cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L))
+#include <span>
+#define DOTCODE_SPAN
+#endif
+
+namespace dotcode {
+
+class Symbol {
+public:
+    Symbol () noexcept = default;
+    Symbol (Symbol &&s) noexcept { Swap(s); }
+    Symbol &operator= (Symbol &&s) noexcept
+    {
+        Symbol gone(std::move(*this));
+        Swap(s);
+        return *this;
+    }
+    Symbol (const Symbol &) = delete;
+    Symbol &operator= (const Symbol &) = delete;
+    ~Symbol ()
+    {
+        if (out.bitmap) mr->deallocate(out.bitmap,nbytes,1);
+    }
+
+    explicit operator bool () const noexcept { return out.bitmap != nullptr; }
+    int Rows () const noexcept { return out.rows; }
+    int Cols () const noexcept { return out.cols; }
+    int Size () const noexcept { return nbytes; }
+    const unsigned char *Data () const noexcept { return out.bitmap; }
+#if defined(DOTCODE_SPAN)
+    std::span<const unsigned char> Bytes () const noexcept { return {out.bitmap,(std::size_t)nbytes}; }
+#endif
+    bool Dot (int x, int y) const noexcept { return DotCodeDot(const_cast<output*>(&out),x,y) != 0; }
+    // (the C API takes a non-const "output", but doesn't change a filled one)
+    output *Get () noexcept { return &out; }
+    const output *Get () const noexcept { return &out; }
+
+private:
+    friend class Encoder;
+
+    void Swap (Symbol &s) noexcept
+    {
+        std::swap(out,s.out);
+        std::swap(nbytes,s.nbytes);
+        std::swap(mr,s.mr);
+    }
+
+    output out = {};
+    int nbytes = 0;
+    std::pmr::memory_resource *mr = nullptr;
+};
+
+class Encoder {
+public:
+    explicit Encoder (std::pmr::memory_resource *mr = std::pmr::get_default_resource()) noexcept
+        : mr(mr) { DotCodeDefaults(&opt); }
+    explicit Encoder (const options &opt, std::pmr::memory_resource *mr = std::pmr::get_default_resource()) noexcept
+        : opt(opt), mr(mr) {}
+
+    options &Options () noexcept { return opt; }
+    std::pmr::memory_resource *Resource () const noexcept { return mr; }
+
+    // "hgt" & "wid" follow the rules of "inputs" (0 & 0 for the usual 2/3)
+    Symbol Encode (std::string_view msg, int hgt = 0, int wid = 0) const
+    {
+        return Encode(reinterpret_cast<const unsigned char*>(msg.data()),msg.size(),hgt,wid);
+    }
+#if defined(DOTCODE_SPAN)
+    Symbol Encode (std::span<const unsigned char> msg, int hgt = 0, int wid = 0) const
+    {
+        return Encode(msg.data(),msg.size(),hgt,wid);
+    }
+    Symbol Encode (std::span<const std::byte> msg, int hgt = 0, int wid = 0) const
+    {
+        return Encode(reinterpret_cast<const unsigned char*>(msg.data()),msg.size(),hgt,wid);
+    }
+#endif
+
+    Symbol Encode (const unsigned char *msg, std::size_t len, int hgt = 0, int wid = 0) const
+    {
+        Symbol s;
+        if (len > INT_MAX) return s;
+        Scratch use(mr);
+        // (the encoder only reads the message)
+        inputs in = {const_cast<unsigned char*>(msg),(int)len,hgt,wid};
+        int n = DotCodeEncodeOptions(&in,&s.out,&opt,0,0);
+        if (n <= 0) return Symbol();
+        s.out.bitmap = static_cast<unsigned char*>(mr->allocate(n,1));
+        s.nbytes = n;
+        s.mr = mr;
+        if (DotCodeEncodeOptions(&in,&s.out,&opt,1,0) != n) return Symbol();
+        return s;
+    }
+
+private:
+    // routes this thread's scratch allocations to "mr" while in scope
+    class Scratch {
+    public:
+        explicit Scratch (std::pmr::memory_resource *mr) noexcept
+            : with{&Alloc,&Release,mr}, was(DotCodeAllocator(&with)) {}
+        ~Scratch () { DotCodeAllocator(was); }
+        Scratch (const Scratch &) = delete;
+        Scratch &operator= (const Scratch &) = delete;
+
+    private:
+        static void *Alloc (void *user, int n) noexcept
+        {
+            try {
+                return static_cast<std::pmr::memory_resource*>(user)->allocate(n,alignof(std::max_align_t));
+            }
+            catch (...) {
+                return nullptr;     // (the C encoder just fails)
+            }
+        }
+        static void Release (void *user, void *p, int n) noexcept
+        {
+            static_cast<std::pmr::memory_resource*>(user)->deallocate(p,n,alignof(std::max_align_t));
+        }
+
+        dotalloc with;
+        const dotalloc *was;
+    };
+
+    options opt;
+    std::pmr::memory_resource *mr;
+};
+
+}   // namespace dotcode
+
+#endif
+#endif
+
+#endif
@@ -0,0 +1,442 @@
+/* ======================================================================= */
+/**  "DotDecod.c" -- DotCode decoding of a bitmap, for inline verification **/
+/* ======================================================================= */
+
+// DotCodeDecode() reverses DotCodeEncode() on a clean bitmap, reading the
+//  dots in the encoder's own placement order, so it needs no image finding
+//  or sampling.  Codewords whose 9-bit patterns aren't legal are treated as
+//  erasures, & should R-S correction then fail, the codewords under the 6
+//  corner dots are erased too (the encoder may have lit those corners).
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define UCHAR unsigned char
+
+#define GF 113      /* Size of the Galois field */
+#define PM 3        /* Prime Modulus for the Galois field */
+
+#define CODE_SET_A 0
+#define CODE_SET_B 1
+#define CODE_SET_C 2
+#define BINARY_MODE 3
+
+#define EOT 04
+#define GS  29
+#define RS  30
+
+/*****  GLOBAL VARIABLES    *****/
+/* (per thread, as for the encoder) */
+THREAD_LOCAL int neras;         /* the # of Erasures &...   */
+THREAD_LOCAL int ocp;           /* the total # of Erasures plus Errors found */
+THREAD_LOCAL int uec;           /* the # of uncorrectable R-S blocks */
+
+static THREAD_LOCAL int rw[MAXWD];          /* the Codewords read (mask word first) */
+static THREAD_LOCAL UCHAR erased[MAXWD];    /* ... & which of them are erased */
+static THREAD_LOCAL UCHAR dw[MAXWD];        /* the unmasked data words */
+static THREAD_LOCAL signed char patval[0x200];  /* each 9-bit pattern's value, or -1 */
+static THREAD_LOCAL int patready;
+
+/* ======================================================================= */
+/* ************************      R-S DECODING     ************************ */
+/* ======================================================================= */
+static int GfPow (int a, int e)
+{
+    int r = 1;
+    for (a%=GF; e; e>>=1,a=(a*a)%GF) if (e & 1) r = (r*a)%GF;
+    return (r);
+}
+#define GfInv(a) GfPow((a),GF-2)
+
+/*-------------------------------------------------------------------------*/
+/*  "rsdecode(c,n,nc,eras,ne)" corrects the "n" word block "c" ("nc" of    */
+/*  them checks) given "ne" erased positions "eras", returning the # of    */
+/*  errors corrected beyond the erasures, or -1 if it is uncorrectable     */
+/*-------------------------------------------------------------------------*/
+static int rsdecode (int *c, int n, int nc, const int *eras, int ne)
+{
+    int S[GF], lam[GF+2], b[GF+2], t[GF+2], om[GF];
+    int i, j, r, L, d, x, deg, found, any;
+
+    for (j=1,any=0; j<=nc; j++) {      // the syndromes, at 3^1 thru 3^nc
+        int v = 0, a = GfPow(PM,j);
+        for (i=0; i<n; i++) v = (v * a + c[i]) % GF;
+        if ((S[j-1] = v)) any = 1;
+    }
+    if (!any) return (0);
+    if (ne > nc) return (-1);
+
+    // start the locator with the erasures, then Berlekamp-Massey the rest
+    memset(lam,0,sizeof(lam));
+    lam[0] = 1;
+    for (i=0; i<ne; i++) {
+        x = GfPow(PM,n-1-eras[i]);
+        for (j=i+1; j>0; j--) lam[j] = (lam[j] + GF - (x * lam[j-1]) % GF) % GF;
+    }
+    memcpy(b,lam,sizeof(lam));
+    for (r=ne+1,L=ne; r<=nc; r++) {
+        for (j=d=0; (j<r)&&(j<=nc); j++) d = (d + lam[j] * S[r-1-j]) % GF;
+        if (d) {
+            for (j=0; j<=nc+1; j++) t[j] = (lam[j] + GF - (d * ((j)? b[j-1]:0)) % GF) % GF;
+            if (2*L <= r+ne-1) {
+                x = GfInv(d);
+                for (j=0; j<=nc+1; j++) b[j] = (lam[j] * x) % GF;
+                L = r+ne-L;
+            }
+            else {
+                for (j=nc+1; j>0; j--) b[j] = b[j-1];
+                b[0] = 0;
+            }
+            memcpy(lam,t,sizeof(lam));
+        }
+        else {
+            for (j=nc+1; j>0; j--) b[j] = b[j-1];
+            b[0] = 0;
+        }
+    }
+    for (deg=nc+1; (deg>0)&&(!lam[deg]); deg--);
+    if ((deg != L)||(deg > nc)) return (-1);
+
+    // the evaluator, then Chien search & Forney for each error value
+    for (i=0; i<nc; i++)
+        for (j=0,om[i]=0; j<=i; j++) om[i] = (om[i] + lam[j] * S[i-j]) % GF;
+    for (i=found=0; i<n; i++) {
+        int xi = GfPow(PM,(GF-1) - (n-1-i) % (GF-1)), num, den, p;
+        for (j=deg,p=0; j>=0; j--) p = (p * xi + lam[j]) % GF;
+        if (p) continue;
+        for (j=nc-1,num=0; j>=0; j--) num = (num * xi + om[j]) % GF;
+        for (j=deg,den=0; j>=1; j--) den = (den * xi + j * lam[j]) % GF;
+        if (!den) return (-1);
+        c[i] = (c[i] + num * GfInv(den)) % GF;      // c - e, where e = -num/den
+        found++;
+    }
+    if (found != deg) return (-1);
+    if (2*found - ne >= nc) return (-1);    // (keeping a check word spare to confirm)
+
+    for (j=1; j<=nc; j++) {             // & make sure it really is a codeword
+        int v = 0, a = GfPow(PM,j);
+        for (i=0; i<n; i++) v = (v * a + c[i]) % GF;
+        if (v) return (-1);
+    }
+    return ((found > ne)? found-ne:0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Correct(nw,info)" R-S corrects the "nw" words of rw[] block by block  */
+/*  (interleaved as rsencode() lays them out), returning 0 if all correct  */
+/*-------------------------------------------------------------------------*/
+static int Correct (int nw, int nc, decodeinfo *info)
+{
+    int c[GF], eras[GF], start, step, i, ne, e;
+
+    step = (nw+GF-2)/(GF-1);
+    neras = ocp = uec = 0;
+    for (start=0; start<step; start++) {
+        int NW = (nw-start+step-1)/step, NC = NW - ((nw-nc-start+step-1)/step);
+        for (i=ne=0; i<NW; i++) {
+            c[i] = rw[start+i*step];
+            if (erased[start+i*step]) eras[ne++] = i;
+        }
+        neras += ne;
+        if ((e = rsdecode(c,NW,NC,eras,ne)) < 0) uec++;
+        else {
+            ocp += ne + e;
+            if (info) info->errors += e;
+            for (i=0; i<NW; i++) rw[start+i*step] = c[i];
+        }
+    }
+    if (info) info->erasures = neras;
+    return ((uec)? -1:0);
+}
+
+/* ======================================================================= */
+/* *********************      MESSAGE DECODING      ********************** */
+/* ======================================================================= */
+typedef struct {
+    UCHAR *msg;
+    int n, maxlen, literal, bad;
+} msgbuf;
+
+static void Put (msgbuf *mb, int c)
+{
+    if ((!mb->literal)&&((c == '#')||(c == 0))) {
+        if (mb->n+2 > mb->maxlen) mb->bad = 1;
+        else {
+            mb->msg[mb->n++] = '#';
+            mb->msg[mb->n++] = (c)? '#':'0';
+        }
+    }
+    else if (mb->n >= mb->maxlen) mb->bad = 1;
+    else mb->msg[mb->n++] = (UCHAR)c;
+}
+
+static void PutFNC (msgbuf *mb, int fnc, long eci)
+{
+    char s[24];
+    int n = (eci >= 0)? sprintf(s,"#2%06ld",eci) : sprintf(s,"#%d",fnc);
+    if ((mb->literal)||(mb->n+n > mb->maxlen)) mb->bad = 1;
+    else {
+        memcpy(mb->msg+mb->n,s,n);
+        mb->n += n;
+    }
+}
+
+static void PutMacro (msgbuf *mb, int macro, int nn, int trailer)
+{
+    if (trailer) {
+        if (macro == 1) Put(mb,RS);
+        Put(mb,EOT);
+    }
+    else {
+        Put(mb,'[');
+        Put(mb,')');
+        Put(mb,'>');
+        Put(mb,RS);
+        Put(mb,'0' + nn/10);
+        Put(mb,'0' + nn%10);
+        if (macro == 1) Put(mb,GS);
+    }
+}
+
+// Binary mode: 6 base 103 digits hold 5 base 259 values (n+1 digits, n)
+typedef struct {
+    int digit[6], ndig;
+    int eci;                // # of ECI bytes still to come (after 256-258)
+    long ecival;
+} binstate;
+
+static int BinFlush (binstate *bs, msgbuf *mb)
+{
+    int v[5], i, j, t, carry, n = bs->ndig-1;
+    if (!bs->ndig) return (0);
+    if (n < 1) return (-1);
+    memset(v,0,sizeof(v));
+    for (i=0; i<bs->ndig; i++) {
+        for (j=4,carry=bs->digit[i]; j>=0; j--) {
+            t = v[j] * 103 + carry;
+            v[j] = t % 259;
+            carry = t / 259;
+        }
+    }
+    bs->ndig = 0;
+    for (i=5-n; i<5; i++) {
+        if (bs->eci) {
+            bs->ecival = (bs->ecival<<8) | v[i];
+            if (!(--bs->eci)) PutFNC(mb,2,bs->ecival);
+        }
+        else if (v[i] > 258) return (-1);
+        else if (v[i] > 255) {
+            bs->eci = v[i] - 255;
+            bs->ecival = 0;
+        }
+        else Put(mb,v[i]);
+    }
+    return (1);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Interpret(CW,nd,mb)" translates the "nd" unmasked data words in "CW"  */
+/*  back into the message, mirroring FindDataWords() mode for mode         */
+/*-------------------------------------------------------------------------*/
+#define SHIFT(m,n) { backto = mode; mode = m; nshift = n; repeat = 1; }
+#define LATCH(m) { mode = m; repeat = 1; }
+#define NEXT(v) { if (i >= nd) return (-1); v = CW[i++]; }
+#define DATUM(c) { Put(mb,c); past = 1; }
+
+static int Interpret (const UCHAR *CW, int nd, msgbuf *mb)
+{
+    int i = 0, v, w, j, mode = CODE_SET_C, backto = 0, nshift = 0, repeat;
+    int past = 0, macro = 0;        // PastFirstDatum, InsideMacro
+    binstate bs;
+
+    memset(&bs,0,sizeof(binstate));
+    while (i < nd) {
+        do {
+            repeat = 0;
+            v = CW[i++];
+            if (mode == BINARY_MODE) {
+                if (v < 103) {
+                    bs.digit[bs.ndig++] = v;
+                    if ((bs.ndig == 6)&&(BinFlush(&bs,mb) > 0)) past = 1;
+                    continue;
+                }
+                if ((j = BinFlush(&bs,mb)) < 0) return (-1);
+                if (j) past = 1;
+                if (v <= 108) SHIFT(CODE_SET_C,v-101)
+                else if (v == 109) LATCH(CODE_SET_A)
+                else if (v == 110) LATCH(CODE_SET_B)
+                else LATCH(CODE_SET_C)
+                continue;
+            }
+
+            // the codewords particular to each Code Set...
+            if (mode == CODE_SET_A) {
+                if (v < 96) DATUM((v < 64)? v+32 : v-64)
+                else if (v <= 101) SHIFT(CODE_SET_B,v-95)
+                else if (v == 102) LATCH(CODE_SET_B)
+                else if (v <= 105) SHIFT(CODE_SET_C,v-101)
+                else if (v == 106) LATCH(CODE_SET_C)
+            }
+            else if (mode == CODE_SET_B) {
+                if (v < 96) DATUM(v+32)
+                else if (v == 96) {
+                    Put(mb,13);
+                    DATUM(10);
+                }
+                else if ((v <= 100)&&(past)) DATUM((v == 97)? 9 : v-98+28)
+                else if (v <= 99) {         // Macro 05, 06 or 12
+                    macro = 1;
+                    PutMacro(mb,macro,(v == 97)? 5 : (v == 98)? 6:12,0);
+                    past = 1;
+                }
+                else if (v == 100) {        // Macro "nn"
+                    NEXT(w);
+                    if (w > 99) return (-1);
+                    macro = 2;
+                    PutMacro(mb,macro,w,0);
+                    past = 1;
+                }
+                else if (v == 101) SHIFT(CODE_SET_A,1)
+                else if (v == 102) LATCH(CODE_SET_A)
+                else if (v <= 105) SHIFT(CODE_SET_C,v-101)
+                else if (v == 106) LATCH(CODE_SET_C)
+            }
+            else {
+                if (v < 100) {
+                    Put(mb,'0' + v/10);
+                    DATUM('0' + v%10);
+                }
+                else if (v == 100) {        // "17xxxxxx10"
+                    Put(mb,'1');
+                    Put(mb,'7');
+                    for (j=0; j<3; j++) {
+                        NEXT(w);
+                        if (w > 99) return (-1);
+                        Put(mb,'0' + w/10);
+                        Put(mb,'0' + w%10);
+                    }
+                    Put(mb,'1');
+                    DATUM('0');
+                }
+                else if (v == 101) LATCH(CODE_SET_A)
+                else if (v <= 105) SHIFT(CODE_SET_B,v-101)
+                else if (v == 106) LATCH(CODE_SET_B)
+            }
+            if (v < 107) continue;
+
+            // ... & those common to all three
+            switch (v) {
+                case 107:
+                    PutFNC(mb,1,-1);
+                    break;
+                case 108:                   // an ECI, in 1 or 3 words
+                    NEXT(w);
+                    if (w < 40) {
+                        PutFNC(mb,2,w);
+                        if (nshift) nshift--;
+                    }
+                    else {
+                        long eci = (long)(w-40) * 12769;
+                        NEXT(w);
+                        eci += w * 113;
+                        NEXT(w);
+                        PutFNC(mb,2,eci + w + 40);
+                        if (nshift) nshift -= 3;
+                    }
+                    break;
+                case 109:
+                    if (macro) PutMacro(mb,macro,0,1);
+                    macro = 0;
+                    PutFNC(mb,3,-1);
+                    if ((mode != CODE_SET_C)&&(past)) mode = CODE_SET_C;
+                    break;
+                case 110:
+                case 111:                   // Binary Shift
+                    NEXT(w);
+                    DATUM(w + ((v == 110)? 64:160));
+                    break;
+                case 112:
+                    LATCH(BINARY_MODE);
+                    break;
+            }
+        }
+        while ((repeat)&&(i < nd));
+        if ((nshift)&&(mode != BINARY_MODE)) {
+            nshift--;
+            if (!nshift) mode = backto;
+        }
+    }
+    if ((mode == BINARY_MODE)&&(BinFlush(&bs,mb) < 0)) return (-1);
+    if (bs.eci) return (-1);
+    if (macro) PutMacro(mb,macro,0,1);
+    return ((mb->bad)? -1 : mb->n);
+}
+
+/* ======================================================================= */
+/* ***********************      DECODING API      ************************ */
+/* ======================================================================= */
+
+int DotCodeDecode (output *out, UCHAR *msg, int maxlen, int literal, decodeinfo *info)
+{
+    dotmap *map;
+    msgbuf mb;
+    const int *pats;
+    int NDOTS, NW, NC, ND, i, k, b, pat, corner, pass, msk, n = -1;
+
+    if (info) memset(info,0,sizeof(decodeinfo));
+    if ((NROW < 5)||(NCOL < 5)||(!((NROW^NCOL)&1))) return (-1);
+    NDOTS = (NROW * NCOL)>>1;
+    NW = (NDOTS - 2) / 9;
+    if ((NW % 3) == 2) NW--;
+    NC = (NW / 3) + 2;
+    ND = NW - NC;
+    if ((ND < 1)||(NW >= MAXWD)) return (-1);
+
+    if (!patready) {
+        pats = CharPatterns();
+        memset(patval,-1,sizeof(patval));
+        for (i=0; i<GF; i++) patval[pats[i]] = (signed char)i;
+        patready = 1;
+    }
+
+    // (the thread's map is kept, so a run of one size maps it just once)
+    if (!(map = ThreadMap(out))) return (-1);
+
+    // the words overlapping the 6 corner dots (the last placed) start here
+    corner = (map->ndots - 6 - 2) / 9 + 1;
+
+    for (pass=0; pass<2; pass++) {
+        if ((pass)&&(corner > NW)) break;   // (no words to erase there)
+        rw[0] = (((map->bit[0] & BMAP[map->byte[0]])? 2:0) | ((map->bit[1] & BMAP[map->byte[1]])? 1:0));
+        erased[0] = 0;
+        for (i=1,k=2; i<=NW; i++) {
+            for (b=pat=0; b<9; b++,k++) pat = (pat<<1) | ((BMAP[map->byte[k]] & map->bit[k])? 1:0);
+            rw[i] = patval[pat];
+            erased[i] = ((rw[i] < 0)||((pass)&&(i >= corner)))? 1:0;
+            if (erased[i]) rw[i] = 0;
+        }
+        if (info) memset(info,0,sizeof(decodeinfo));
+        if ((!Correct(NW+1,NC,info))&&(rw[0] < 4)) break;
+    }
+
+    if ((pass < 2)&&(!uec)&&(rw[0] < 4)) {
+        msk = rw[0];
+        for (i=0; i<ND; i++) dw[i] = (UCHAR)((rw[i+1] + GF - (i * mask[msk]) % GF) % GF);
+        mb.msg = msg;
+        mb.n = mb.bad = 0;
+        mb.maxlen = maxlen;
+        mb.literal = literal;
+        n = Interpret(dw,ND,&mb);
+        if (info) {
+            info->mask = msk;
+            info->nd = ND;
+            info->nc = NC;
+        }
+    }
+    return (n);
+}
@@ -47,9 +47,12 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 
 #include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
 
 #define BOOL char
 #define UCHAR unsigned char
@@ -61,52 +64,132 @@
 
 #define SCORE_UNLIT_EDGE    -99999
 
+// The C++ build (DotEncod.cpp) takes its field arithmetic, R-S generators
+//  & mask ramps from the compile-time tables of "DotTable.hpp" instead
+#if defined(__cplusplus)
+#include "DotTable.hpp"
+namespace dctab = dotcode::tables;
+#define GFMUL(a,b) (dctab::mul[a][b])
+#define RAMP(m,i) (dctab::ramp[m][i])
+#else
+#define GFMUL(a,b) (((a) * (b)) % GF)
+#define RAMP(m,i) (((i) * mask[m]) % GF)
+#endif
+
 /*****  GLOBAL VARIABLES    *****/
-int wd[5000];           /* array of Codewords (data plus checks) in order */
+/* (per thread, so that separate threads may encode concurrently) */
+THREAD_LOCAL int wd[MAXWD];         /* array of Codewords (data plus checks) in order */
 int lg[GF], alg[GF];    /* arrays for log and antilog values */
-int neras;          /* the # of Erasures &...   */
-int ocp;            /* the total # of Erasures plus Errors found */
-int uec;
+
+/* ======================================================================= */
+/* **********************      SCRATCH MEMORY     ************************ */
+/* ======================================================================= */
+/*-------------------------------------------------------------------------*/
+/*  "DotAlloc(n)" & "DotFree(p)" get & return an encoding's scratch memory */
+/*  from the calling thread's allocator, else malloc().  Each block leads  */
+/*  with its size & allocator, so that any thread may free it              */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    const dotalloc *from;   // the allocator (NULL for malloc())...
+    int size;               // ... & the block size asked of it
+} scratchhdr;
+
+#define SCRATCH_HDR 16      /* (keeps the block aligned as malloc() would) */
+
+static THREAD_LOCAL const dotalloc *scratch;
+
+const dotalloc *DotCodeAllocator (const dotalloc *a)
+{
+    const dotalloc *was = scratch;
+    scratch = a;
+    return (was);
+}
+
+void *DotAlloc (int n)
+{
+    const dotalloc *a = scratch;
+    scratchhdr *h;
+    if ((n < 0)||(n > INT_MAX - SCRATCH_HDR)) return (NULL);
+    h = (scratchhdr*)((a)? a->alloc(a->user,n + SCRATCH_HDR) : malloc(n + SCRATCH_HDR));
+    if (!h) return (NULL);
+    h->from = a;
+    h->size = n + SCRATCH_HDR;
+    return ((UCHAR*)h + SCRATCH_HDR);
+}
+
+void DotFree (void *p)
+{
+    scratchhdr *h;
+    if (!p) return;
+    h = (scratchhdr*)((UCHAR*)p - SCRATCH_HDR);
+    if (h->from) h->from->release(h->from->user,h,h->size);
+    else free(h);
+}
 
 /* ======================================================================= */
 /* ************************      R-S ENCODING     ************************ */
 /* ======================================================================= */
+/*-------------------------------------------------------------------------*/
+/*  "GenPoly(nc)" returns the R-S generator polynomial "c" of order "nc"   */
+/*  The last two are kept, since a run of symbols (or the interleaved      */
+/*  blocks of one large symbol) rarely needs more than two different ones  */
+/*-------------------------------------------------------------------------*/
+#if defined(__cplusplus)
+const UCHAR *GenPoly (int nc)
+{
+    return (dctab::gen[nc]);
+}
+#else
+static THREAD_LOCAL UCHAR gpoly[2][GF];
+static THREAD_LOCAL int gorder[2], glast;
+
+const UCHAR *GenPoly (int nc)
+{
+    int i, j, root;
+    UCHAR *c;
+
+    for (i=0; i<2; i++) if (gorder[i] == nc+1) return (gpoly[i]);
+    glast ^= 1;
+    c = gpoly[glast];
+    gorder[glast] = nc+1;
+
+    /* generate the "nc" roots (antilogs) as we go, multiplying them in: */
+    for (i=1; i<=nc; i++) c[i] = 0;
+    c[0] = 1;
+    for (i=1,root=1; i<=nc; i++) {
+        root = (PM * root) % GF;
+        for (j=nc; j>=1; j--) {
+            c[j] = (GF + c[j] - (root * c[j-1]) % GF) % GF;
+        }
+    }
+    return (c);
+}
+#endif
+
 /*-------------------------------------------------------------------------*/
 /*  "rsencode(nd,nc)" adds "nc" R-S check words to "nd" data words in wd[]  */
 /*-------------------------------------------------------------------------*/
 void rsencode (int nd, int nc)
 {
     int i, j, k, nw, start, step;
-    int root[GF], c[GF];
+    const UCHAR *c;
 
     nw = nd+nc;
     step = (nw+GF-2)/(GF-1);
     for (start=0; start<step; start++) {
         int ND = (nd-start+step-1)/step, NW = (nw-start+step-1)/step, NC = NW-ND;
 
-        /* First time through, begin by generating "NC+1" roots (antilogs):   */
-        if (!start) {   // LARGE FIX
-            root[0] = 1;
-            for (i=1; i<=(NC+1); i++) root[i] = (PM * root[i-1]) % GF;
-        }
-
-        /* Compute also the generator polynomial "c" of order "NC": */
-        for (i=1; i<=NC; i++) c[i] = 0;
-        c[0] = 1;
-        for (i=1; i<=NC; i++) {
-            for (j=NC; j>=1; j--) {
-                c[j] = (GF + c[j] - (root[i] * c[j-1]) % GF) % GF;
-            }
-        }
+        /* Fetch the generator polynomial "c" of order "NC": */
+        c = GenPoly(NC);
 
         // Finally compute the corresponding checkword values into wd[], starting at wd[start] & stepping by step
         for (i=ND; i<NW; i++) wd[start+i*step] = 0;
         for (i=0; i<ND; i++) {
             k = (wd[start+i*step] + wd[start+ND*step]) % GF;
             for (j=0; j<NC-1; j++) {
-                wd[start+(ND+j)*step] = (GF - ((c[j+1] * k) % GF) + wd[start+(ND+j+1)*step]) % GF;
+                wd[start+(ND+j)*step] = (GF - GFMUL(c[j+1],k) + wd[start+(ND+j+1)*step]) % GF;
             }
-            wd[start+(ND+NC-1)*step] = (GF - ((c[NC] * k) % GF)) % GF;
+            wd[start+(ND+NC-1)*step] = (GF - GFMUL(c[NC],k)) % GF;
         }
         for (i=ND; i<NW; i++) wd[start+i*step] = (GF - wd[start+i*step]) % GF;
 
@@ -117,9 +200,11 @@ void rsencode (int nd, int nc)
 /* *********************      MESSAGE ENCODING      ********************** */
 /* ======================================================================= */
 /*****  MORE GLOBAL VARIABLES   *****/
-UCHAR *cw;
-char PastFirstDatum, InsideMacro;   // some status flags
-int Base103[6], bincnt; // accomodates Binary Mode compaction
+THREAD_LOCAL UCHAR *cw;
+THREAD_LOCAL char PastFirstDatum, InsideMacro;  // some status flags
+THREAD_LOCAL int Base103[6], bincnt;    // accomodates Binary Mode compaction
+THREAD_LOCAL unsigned long long binval; // ... the same, as one 64-bit value
+THREAD_LOCAL char binref;               // ... or by Base103[] (reference mode)
 
 #define FNC1 256
 #define FNC2 257
@@ -140,15 +225,27 @@ int Base103[6], bincnt; // accomodates Binary Mode compaction
 #define STORE(a) *(cw++) = (a)
 #define STOREDATUM(a) { STORE(a); PastFirstDatum = 1; }
 
-int nDigits (int *c)
+THREAD_LOCAL tokens tk;     // the message being encoded
+
+/*-------------------------------------------------------------------------*/
+/*  "Tok(i)" returns token "i" of the message: a byte, an FNCx, or END     */
+/*-------------------------------------------------------------------------*/
+static int Tok (int i)
+{
+    if (i >= tk.n) return (END);
+    if ((tk.fnc)&&(tk.fnc[i>>3] & (1<<(i&7)))) return (FNC1-1 + tk.b[i]);
+    return (tk.b[i]);
+}
+
+int nDigits (int c)
 {
-    int *last = c;
-    while (DIGIT(*last)) last++;
+    int last = c;
+    while (DIGIT(Tok(last))) last++;
     return (last-c);
 }
-void StoreC (int *c)
+void StoreC (int c)
 {
-    int v = (*c-'0') * 10 + (*(c+1)-'0');
+    int v = (Tok(c)-'0') * 10 + (Tok(c+1)-'0');
     STOREDATUM(v);
 }
 
@@ -180,33 +277,33 @@ BOOL DatumB (int c)
 {
     return ((TWIX(32,127,c)||((PastFirstDatum)&&((c==9)||TWIX(28,30,c)))||(FNCx(c)))? TRUE:FALSE);
 }
-BOOL CrLf (int *c)
+BOOL CrLf (int c)
 {
-    return (((*c==CR)&&(*(c+1)==LF))? TRUE:FALSE);
+    return (((Tok(c)==CR)&&(Tok(c+1)==LF))? TRUE:FALSE);
 }
-BOOL DigitPair (int *c)
+BOOL DigitPair (int c)
 {
-    return (((DIGIT(*c))&&(DIGIT(*(c+1))))? TRUE:FALSE);
+    return (((DIGIT(Tok(c)))&&(DIGIT(Tok(c+1))))? TRUE:FALSE);
 }
-BOOL SeventeenTen (int *c)
+BOOL SeventeenTen (int c)
 {
-    return (((nDigits(c)>=10)&&(*c=='1')&&(*(c+1)=='7')&&(*(c+8)=='1')&&(*(c+9)=='0'))? TRUE:FALSE);
+    return (((nDigits(c)>=10)&&(Tok(c)=='1')&&(Tok(c+1)=='7')&&(Tok(c+8)=='1')&&(Tok(c+9)=='0'))? TRUE:FALSE);
 }
 BOOL Binary (int c)
 {
     return ((TWIX(128,255,c))? TRUE:FALSE);
 }
-BOOL ECI (int *c, long *v)
+BOOL ECI (int c, long *v)
 {
-    if ((*c == FNC2)&&(nDigits(c+1) >= 6)) {
+    if ((Tok(c) == FNC2)&&(nDigits(c+1) >= 6)) {
         int n;
-        for (n=6,*v=0; n; n--) *v = *v * 10 + (*(++c)-'0');
+        for (n=6,*v=0; n; n--) *v = *v * 10 + (Tok(++c)-'0');
         return (TRUE);
     }
     return (FALSE);
 }
 
-int StoreFNC2 (int *c, int *nshift)
+int StoreFNC2 (int c, int *nshift)
 {
     long j;
     STORE(108);
@@ -227,7 +324,7 @@ int StoreFNC2 (int *c, int *nshift)
     else return (1);
 }
 
-int AheadC (int *c)
+int AheadC (int c)
 {
     int n = 0, x;
     do {
@@ -242,7 +339,7 @@ int AheadC (int *c)
             n++;
             continue;
         }
-        if (FNCx(*c)) {
+        if (FNCx(Tok(c))) {
             c++;
             n++;
             continue;
@@ -251,16 +348,16 @@ int AheadC (int *c)
     while (n > x);
     return (n);
 }
-int TryC (int *c)
+int TryC (int c)
 {
-    if (DIGIT(*c)) {
+    if (DIGIT(Tok(c))) {
         int n = AheadC(c);
         if (n > AheadC(c+1)) return (n);
     }
     return (0);
 }
 
-int AheadA (int *c)
+int AheadA (int c)
 {
     int n = 0, x;
     long j;
@@ -272,7 +369,7 @@ int AheadA (int *c)
             n += ((j <= 49)? 2:4);
             continue;
         }
-        if (DatumA(*c)) {
+        if (DatumA(Tok(c))) {
             c++;
             n++;
             continue;
@@ -281,7 +378,7 @@ int AheadA (int *c)
     while (n > x);
     return (n);
 }
-int AheadB (int *c)
+int AheadB (int c)
 {
     int n = 0, x;
     long j;
@@ -298,7 +395,7 @@ int AheadB (int *c)
             n++;
             continue;
         }
-        if (DatumB(*c)) {
+        if (DatumB(Tok(c))) {
             c++;
             n++;
             continue;
@@ -308,21 +405,34 @@ int AheadB (int *c)
     return (n);
 }
 
-// routines for filling and then outputting Binary mode characters
+// routines for filling and then outputting Binary mode characters: up to 5
+//  base 259 values (< 259^5, which is < 103^6 & 2^41) accumulate in "binval"
+//  & are then converted to base 103 at once, instead of every 6 base 103
+//  digits in Base103[] being carried at each value, as the reference did
 static void BinFinish (void)
 {
-    int *wd;
-    if (bincnt) {
+    int *wd, i;
+    if ((bincnt)&&(!binref)) {
+        for (i=bincnt; i>=0; i--) {
+            cw[i] = (UCHAR)(binval % 103);
+            binval /= 103;
+        }
+        cw += bincnt+1;
+        PastFirstDatum = 1;
+    }
+    else if (bincnt) {
         for (wd=Base103+5-bincnt; wd<=Base103+5; wd++) STORE(*wd);
         PastFirstDatum = 1;
     }
     memset(Base103,0,sizeof(int)*6);
+    binval = 0;
     bincnt = 0;
 }
 static void BinAdd (int c)
 {
     int *wd;
-    for (wd=Base103+5; wd>=Base103; wd--) {
+    if (!binref) binval = binval * 259 + c;
+    else for (wd=Base103+5; wd>=Base103; wd--) {
         *wd = *wd * 259 + c;
         c = *wd/103;
         *wd %= 103;
@@ -334,288 +444,480 @@ static void BinAdd (int c)
 }
 
 /*-------------------------------------------------------------------------*/
-/*  "FindDatawords(*msg,msglen,*cw)" encodes a'la Code 128                      */
+/*  "Gs1Tokens(tk,msg,msglen)" makes the GS1 element strings of "msg",     */
+/*  written "(AI)data(AI)data...", a token stream: an FNC1 first, then     */
+/*  each AI & its data, with an FNC1 ending each of variable length (but   */
+/*  the last).  Every predefined length element is an even # of digits, so */
+/*  when each run of digits up to an FNC1 is even too, "pairs" is set      */
 /*-------------------------------------------------------------------------*/
-int FindDataWords (UCHAR *msg, int msglen, UCHAR *CW, int literal)
+// element (AI + data) lengths predefined by the AI's first 2 digits, else 0
+static const UCHAR Gs1Len[100] = {
+    20,16,16,16,18, 0, 0, 0, 0, 0,  0, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+     4, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0,10,10,10,10,10,10, 0, 0, 0,
+     0,16, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+     0, 0, 0, 0, 0, 0, 0, 0, 0, 0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// the data characters GS1 allows (its "set 82"), less "(", which begins an AI
+#define GS1CHAR(c) ((TWIX(33,126,c))&&(!strchr("#$(@[\\]^`{|}~",c)))
+
+static int Gs1Tokens (tokens *tk, UCHAR *msg, int msglen)
 {
-    int *Msg = (int*)malloc(sizeof(int) * (msglen + 8));    // extra, for END and then some look-aheads...
-    int mode = 2;
-    cw = CW;
-    if (Msg) {
-        int i, *M = Msg, *Mend = M + msglen + 8;
-        UCHAR *m = msg;
-        BOOL ok = TRUE;
-        while ((msglen--)&&(ok)) {
-            UCHAR c = *(m++);
-            if ((c != '#')||(literal)) *(M++) = c;
-            else {
-                if (msglen--) switch (*(m++)) {
-                        case '#':
-                            *(M++) = '#';
-                            break;    // '#'
-                        case '0':
-                            *(M++) = 0;
-                            break;  // <NUL>
-                        case '1':
-                            *(M++) = FNC1;
-                            break;
-                        case '2':
-                            *(M++) = FNC2;
-                            break;
-                        case '3':
-                            *(M++) = FNC3;
-                            break;
-                        default:
-                            ok = FALSE;
-                    }
-                else ok = FALSE;
-            }
+    UCHAR *b, *fnc;
+    int i = 0, k, ai, fixed, n = 0, run = 0, pairs = 1, bad = 0;
+
+    memset(tk,0,sizeof(tokens));
+    tk->own = b = (UCHAR*)DotAlloc(sizeof(UCHAR) * (msglen + 1 + ((msglen + 1)>>3) + 1));
+    if (!b) return (-1);
+    fnc = b + msglen + 1;
+    memset(fnc,0,((msglen + 1)>>3) + 1);
+    fnc[0] = 1;
+    b[n++] = 1;     // (FNC1 in first position)
+    while (i < msglen) {
+        bad = 1;
+        // the "(AI)", 2 to 4 digits...
+        if (msg[i++] != '(') break;
+        for (k=i; (k<msglen)&&(DIGIT(msg[k])); k++);
+        if ((k-i < 2)||(k-i > 4)||(k >= msglen)||(msg[k] != ')')) break;
+        fixed = Gs1Len[(msg[i]-'0')*10 + msg[i+1]-'0'];
+        for (ai=n; i<k; i++) b[n++] = msg[i];
+        // ... & its data, up to the next "(" (not empty)
+        for (i=k+1, k=n; (i<msglen)&&(GS1CHAR(msg[i])); i++) b[n++] = msg[i];
+        if ((n == k)||((i < msglen)&&(msg[i] != '('))) break;
+        if ((fixed)&&(n-ai != fixed)) break;
+        bad = 0;
+        for (k=ai; k<n; k++) {
+            if (DIGIT(b[k])) run++;
+            else pairs = 0;
         }
-        while (M < Mend) *(M++) = END;
+        if ((!fixed)&&(i < msglen)) {
+            fnc[n>>3] |= 1<<(n&7);
+            b[n++] = 1;
+            if (run & 1) pairs = 0;
+            run = 0;
+        }
+    }
+    if ((bad)||(n == 1)) {
+        FreeTokens(tk);
+        return (-1);
+    }
+    tk->b = b;
+    tk->fnc = fnc;
+    tk->n = n;
+    tk->pairs = ((pairs)&&(!(run & 1)))? 1:0;
+    return (0);
+}
 
-        if (ok) {
-            int j, repeat, nshift, backto;
-            long v;
-            nshift = backto = bincnt = 0;
+/*-------------------------------------------------------------------------*/
+/*  "BinRun(M)" adds token "M" to Binary mode, & then as many more of the  */
+/*  bytes following as it would take one at a time (those > 127, & those  */
+/*  not digits but with one > 127 in the next 3), without the mode checks */
+/*-------------------------------------------------------------------------*/
+static int BinRun (int M)
+{
+    const UCHAR *b = tk.b;
+    int k, n = tk.n;
+
+    BinAdd(Tok(M++));
+    if (tk.fnc) return (M);     // (FNCs & ECIs take the usual course)
+    while (M < n) {
+        if (b[M] < 128) {
+            if (DIGIT(b[M])) break;
+            for (k=M+1; (k<n)&&(k<M+4)&&(b[k]<128); k++);
+            if ((k >= n)||(k >= M+4)) break;
+        }
+        // 5 bytes make 6 codewords, so a run of them is taken at once
+        if ((bincnt)||(M+5 > n)||((b[M] & b[M+1] & b[M+2] & b[M+3] & b[M+4]) < 128)) BinAdd(b[M++]);
+        else {
+            binval = (((((unsigned long long)b[M] * 259 + b[M+1]) * 259 + b[M+2]) * 259 + b[M+3]) * 259) + b[M+4];
+            bincnt = 5;
             BinFinish();
-            PastFirstDatum = InsideMacro = FALSE;
-            for (M=Msg; *M<END;) {
-                do {
-                    repeat = FALSE;
-                    if ((InsideMacro == 1)&&(*M == RS)&&(*(M+1) == EOT)&&((*(M+2) == FNC3)||(*(M+2) == END))) {
-                        M += 2;
-                        InsideMacro = FALSE;
+            M += 5;
+        }
+    }
+    return (M);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Tokenize(tk,msg,msglen,literal)" makes "msg" a token stream, checking */
+/*  its "#x" sequences in the same pass.  A message with none is used in   */
+/*  place; otherwise the tokens are compacted, a byte each, FNCs flagged   */
+/*-------------------------------------------------------------------------*/
+int Tokenize (tokens *tk, UCHAR *msg, int msglen, int literal)
+{
+    const UCHAR *hash = (literal)? NULL : (const UCHAR*)memchr(msg,'#',msglen);
+    UCHAR *b, *fnc;
+    int i, n;
+
+    if (literal == GS1_TOKENS) return (Gs1Tokens(tk,msg,msglen));
+    memset(tk,0,sizeof(tokens));
+    tk->b = msg;
+    tk->n = msglen;
+    if (!hash) return (0);
+
+    n = (int)(hash - msg);
+    tk->own = b = (UCHAR*)DotAlloc(sizeof(UCHAR) * (msglen + (msglen>>3) + 1));
+    if (!b) return (-1);
+    fnc = b + msglen;
+    memset(fnc,0,(msglen>>3) + 1);
+    memcpy(b,msg,n);
+    for (i=n; i<msglen; i++) {
+        if (msg[i] != '#') b[n++] = msg[i];
+        else if (i+1 >= msglen) break;      // (a lone "#" ending it)
+        else if (msg[++i] == '#') b[n++] = '#';
+        else if (msg[i] == '0') b[n++] = 0;   // <NUL>
+        else if (TWIX('1','3',msg[i])) {
+            fnc[n>>3] |= 1<<(n&7);
+            b[n++] = msg[i]-'0';
+        }
+        else break;
+    }
+    if (i < msglen) {
+        FreeTokens(tk);
+        return (-1);
+    }
+    tk->b = b;
+    tk->fnc = fnc;
+    tk->n = n;
+    return (0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "RawTokens(tk,msg,msglen,fncs,nfnc)" makes the literal bytes of "msg"  */
+/*  a token stream with the "nfnc" FNCs of the list "fncs" inserted        */
+/*-------------------------------------------------------------------------*/
+int RawTokens (tokens *tk, UCHAR *msg, int msglen, const fncmark *fncs, int nfnc)
+{
+    UCHAR *b, *fnc;
+    int i, k, n = msglen + nfnc;
+
+    memset(tk,0,sizeof(tokens));
+    tk->b = msg;
+    tk->n = msglen;
+    if (nfnc <= 0) return ((nfnc)? -1:0);
+
+    tk->own = b = (UCHAR*)DotAlloc(sizeof(UCHAR) * (n + (n>>3) + 1));
+    if (!b) return (-1);
+    fnc = b + n;
+    memset(fnc,0,(n>>3) + 1);
+    for (i=k=n=0; i<=msglen; i++) {
+        for (; (k<nfnc)&&(fncs[k].at == i)&&(TWIX(1,3,fncs[k].fnc)); k++) {
+            fnc[n>>3] |= 1<<(n&7);
+            b[n++] = (UCHAR)fncs[k].fnc;
+        }
+        if (i < msglen) b[n++] = msg[i];
+    }
+    if (k < nfnc) {     // (out of order, out of range, or not FNC1-3)
+        FreeTokens(tk);
+        return (-1);
+    }
+    tk->b = b;
+    tk->fnc = fnc;
+    tk->n = n;
+    return (0);
+}
+
+void FreeTokens (tokens *tk)
+{
+    DotFree(tk->own);
+    memset(tk,0,sizeof(tokens));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "PairWords(*t,*cw)" encodes a stream of FNC1s & even runs of digits    */
+/*  exactly as EncodeTokens() does, but without its lookahead, since it    */
+/*  never leaves Code Set C                                                */
+/*-------------------------------------------------------------------------*/
+static int PairWords (const tokens *t, UCHAR *CW)
+{
+    int M;
+
+    cw = CW;
+    tk = *t;
+    for (M=0; M<tk.n;) {
+        if (Tok(M) == FNC1) {
+            STORE(107);
+            M++;
+        }
+        else if (SeventeenTen(M)) {
+            STOREDATUM(100);
+            StoreC(M+2);
+            StoreC(M+4);
+            StoreC(M+6);
+            M += 10;
+        }
+        else {
+            StoreC(M);
+            M += 2;
+        }
+    }
+    *cw = CODE_SET_C;
+    return (cw - CW);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EncodeTokens(*t,*cw)" encodes a'la Code 128                           */
+/*-------------------------------------------------------------------------*/
+int EncodeTokens (const tokens *t, UCHAR *CW)
+{
+    int i, j, M, repeat, nshift, backto, mode = 2;
+    long v;
+
+    // (the reference encoder had no such shortcut)
+    if ((t->pairs)&&(!RefMode())) return (PairWords(t,CW));
+    cw = CW;
+    tk = *t;
+    nshift = backto = bincnt = 0;
+    binref = (char)RefMode();
+    BinFinish();
+    PastFirstDatum = InsideMacro = FALSE;
+    for (M=0; Tok(M)<END;) {
+        do {
+            repeat = FALSE;
+            if ((InsideMacro == 1)&&(Tok(M) == RS)&&(Tok(M+1) == EOT)&&((Tok(M+2) == FNC3)||(Tok(M+2) == END))) {
+                M += 2;
+                InsideMacro = FALSE;
+            }
+            else if ((InsideMacro == 2)&&(Tok(M) == EOT)&&((Tok(M+1) == FNC3)||(Tok(M+1) == END))) {
+                M++;
+                InsideMacro = FALSE;
+            }
+            if (Tok(M) >= END) break;
+            switch (mode) {
+
+                case CODE_SET_A:
+                    /* Check Code Set C */
+                    if ((i = TryC(M)) >= 2) {
+                        if (i <= 4) SHIFT(101+i,CODE_SET_C,i) else LATCH(106,CODE_SET_C);
+                        break;
+                    }
+                    /* Try Codeset A */         if TWIX(0,95,Tok(M)) {
+                        STOREDATUM((Tok(M++)+64)%96);
+                        break;
                     }
-                    else if ((InsideMacro == 2)&&(*M == EOT)&&((*(M+1) == FNC3)||(*(M+1) == END))) {
+                    if (Tok(M) == FNC1) {
+                        STORE(107);
                         M++;
-                        InsideMacro = FALSE;
+                        break;
                     }
-                    if (*M >= END) break;
-                    switch (mode) {
-
-                        case CODE_SET_A:
-                            /* Check Code Set C */
-                            if ((i = TryC(M)) >= 2) {
-                                if (i <= 4) SHIFT(101+i,CODE_SET_C,i) else LATCH(106,CODE_SET_C);
-                                break;
-                            }
-                            /* Try Codeset A */         if TWIX(0,95,*M) {
-                                STOREDATUM((*(M++)+64)%96);
-                                break;
-                            }
-                            if (*M == FNC1) {
-                                STORE(107);
-                                M++;
-                                break;
-                            }
-                            if (*M == FNC2) {
-                                M += StoreFNC2(M,&nshift);
-                                break;
-                            }
-                            if (*M == FNC3) {
-                                STORE(109);
-                                M++;
-                                if (PastFirstDatum) mode = CODE_SET_C;
-                                break;
-                            }
-                            /* is it Binary? */         if (*M > 127) {
-                                if (DatumA(*(M+1))) BinShift(*(M++));
-                                else LATCH(112,BINARY_MODE);
-                                break;
-                            }
-                            /* else Codeset B */            if ((i = AheadB(M)) <= 6) SHIFT(95+i,CODE_SET_B,i) else LATCH(102,CODE_SET_B);
-                            break;
-
-                        case CODE_SET_B:
-                            /* Check Code Set C */
-                            if ((i = TryC(M)) >= 2) {
-                                if (i <= 4) SHIFT(101+i,CODE_SET_C,i) else LATCH(106,CODE_SET_C);
-                                break;
-                            }
-                            /* Try Codeset B */         if TWIX(32,127,*M) {
-                                STOREDATUM(*(M++)-32);
-                                break;
-                            }
-                            if ((*M == 13)&&(*(M+1) == 10)) {
-                                STOREDATUM(96);
-                                M += 2;
-                                break;
-                            }
-                            if (PastFirstDatum) {
-                                if (*M == 9) {
-                                    STOREDATUM(97);
-                                    M++;
-                                    break;
-                                }
-                                if (TWIX(28,30,*M)) {
-                                    STOREDATUM(98 + *(M++)-28);
-                                    break;
-                                }
-                            }
-                            if (*M == FNC1) {
-                                STORE(107);
-                                M++;
-                                break;
-                            }
-                            if (*M == FNC2) {
-                                M += StoreFNC2(M,&nshift);
-                                break;
-                            }
-                            if (*M == FNC3) {
-                                STORE(109);
-                                M++;
-                                if (PastFirstDatum) mode = CODE_SET_C;
-                                break;
-                            }
-                            /* Is it Binary? */         if (*M > 127) {
-                                if (DatumB(*(M+1))) BinShift(*(M++));
-                                else LATCH(112,BINARY_MODE);
-                                break;
-                            }
-                            /* else Codeset A */            if ((i = AheadA(M)) == 1) SHIFT(101,CODE_SET_A,1) else LATCH(102,CODE_SET_A);
+                    if (Tok(M) == FNC2) {
+                        M += StoreFNC2(M,&nshift);
+                        break;
+                    }
+                    if (Tok(M) == FNC3) {
+                        STORE(109);
+                        M++;
+                        if (PastFirstDatum) mode = CODE_SET_C;
+                        break;
+                    }
+                    /* is it Binary? */         if (Tok(M) > 127) {
+                        if (DatumA(Tok(M+1))) BinShift(Tok(M++));
+                        else LATCH(112,BINARY_MODE);
+                        break;
+                    }
+                    /* else Codeset B */            if ((i = AheadB(M)) <= 6) SHIFT(95+i,CODE_SET_B,i) else LATCH(102,CODE_SET_B);
+                    break;
+
+                case CODE_SET_B:
+                    /* Check Code Set C */
+                    if ((i = TryC(M)) >= 2) {
+                        if (i <= 4) SHIFT(101+i,CODE_SET_C,i) else LATCH(106,CODE_SET_C);
+                        break;
+                    }
+                    /* Try Codeset B */         if TWIX(32,127,Tok(M)) {
+                        STOREDATUM(Tok(M++)-32);
+                        break;
+                    }
+                    if ((Tok(M) == 13)&&(Tok(M+1) == 10)) {
+                        STOREDATUM(96);
+                        M += 2;
+                        break;
+                    }
+                    if (PastFirstDatum) {
+                        if (Tok(M) == 9) {
+                            STOREDATUM(97);
+                            M++;
                             break;
-
-                        case CODE_SET_C:
-                        default:
-                            // in first data position, check for a Macro
-                            if ((!PastFirstDatum)&&(*M == '[')&&(*(M+1) == ')')&&(*(M+2) == '>')&&(*(M+3) == RS)
-                                    &&(DigitPair(M+4))) {   // Got the Start of a Macro
-                                int *m = M+7;
-                                while (((*m)!=FNC3)&&((*m)!=END)) m++;
-                                if (*(m-1) == EOT) {    // ... and the ending too!
-                                    LATCH(106,CODE_SET_B);
-                                    i = (*(M+4)-'0')*10 + *(M+5)-'0';
-                                    if ((*(M+6) == GS)&&(*(m-2) == RS)) {
-                                        switch (i) {
-                                            case 05:
-                                                STOREDATUM(97);
-                                                break;
-                                            case 06:
-                                                STOREDATUM(98);
-                                                break;
-                                            case 12:
-                                                STOREDATUM(99);
-                                                break;
-                                            default:
-                                                break;
-                                        }
-                                        if (PastFirstDatum) {
-                                            InsideMacro = 1;
-                                            M += 7;
-                                        }
-                                    }
-                                    if (!PastFirstDatum) {
-                                        STOREDATUM(100);
-                                        STORE(i);
-                                        InsideMacro = 2;
-                                        M += 6;
-                                    }
-                                }
-                                if (InsideMacro) break;
-                            }
-                            // otherwise... always continue in C if at all possible
-                            if (nDigits(M) >= 2) {
-                                if (SeventeenTen(M)) {
-                                    STOREDATUM(100);
-                                    StoreC(M+2);
-                                    StoreC(M+4);
-                                    StoreC(M+6);
-                                    M += 10;
-                                }
-                                else {
-                                    StoreC(M);
-                                    M += 2;
-                                }
-                                break;
-                            }
-                            if (*M == FNC1) {
-                                STORE(107);
-                                M++;
-                                break;
-                            }
-                            if (*M == FNC2) {
-                                M += StoreFNC2(M,&nshift);
-                                break;
-                            }
-                            if (*M == FNC3) {
-                                STORE(109);
-                                M++;
-                                break;
-                            }
-                            /* Check for Binary */      if (*M > 127) {
-                                if (DigitPair(M+1)) BinShift(*(M++));
-                                else LATCH(112,BINARY_MODE);
-                                break;
-                            }
-                            /* else to A or B */        if ((i = AheadA(M)) > (j = AheadB(M))) {
-                                LATCH(101,CODE_SET_A);    // to Codeset A
-                            }
-                            else {
-                                if (j <= 4) SHIFT(101+j,CODE_SET_B,j) else LATCH(106,CODE_SET_B);    // to Codeset B
-                            }
+                        }
+                        if (TWIX(28,30,Tok(M))) {
+                            STOREDATUM(98 + Tok(M++)-28);
                             break;
-
-                        case BINARY_MODE:
-                            /* Check Code Set C */
-                            if ((i = TryC(M)) >= 2) {   // if "favorable",
-                                BinFinish();
-                                if (i <= 7) SHIFT(101+i,CODE_SET_C,i) else LATCH(111,CODE_SET_C);
-                                break;
-                            }
-                            /* Try Binary */                if ((ECI(M,&v))&&((Binary(*(M+7)))||(*(M+7) == END))) { // an ECI?...
-                                if (v < 256) {
-                                    BinAdd(256);
-                                    BinAdd(v);
-                                }
-                                else if (v < 65563) {
-                                    BinAdd(257);
-                                    BinAdd(v>>8);
-                                    BinAdd(v&0xff);
+                        }
+                    }
+                    if (Tok(M) == FNC1) {
+                        STORE(107);
+                        M++;
+                        break;
+                    }
+                    if (Tok(M) == FNC2) {
+                        M += StoreFNC2(M,&nshift);
+                        break;
+                    }
+                    if (Tok(M) == FNC3) {
+                        STORE(109);
+                        M++;
+                        if (PastFirstDatum) mode = CODE_SET_C;
+                        break;
+                    }
+                    /* Is it Binary? */         if (Tok(M) > 127) {
+                        if (DatumB(Tok(M+1))) BinShift(Tok(M++));
+                        else LATCH(112,BINARY_MODE);
+                        break;
+                    }
+                    /* else Codeset A */            if ((i = AheadA(M)) == 1) SHIFT(101,CODE_SET_A,1) else LATCH(102,CODE_SET_A);
+                    break;
+
+                case CODE_SET_C:
+                default:
+                    // in first data position, check for a Macro
+                    if ((!PastFirstDatum)&&(Tok(M) == '[')&&(Tok(M+1) == ')')&&(Tok(M+2) == '>')&&(Tok(M+3) == RS)
+                            &&(DigitPair(M+4))) {   // Got the Start of a Macro
+                        int m = M+7;
+                        while ((Tok(m)!=FNC3)&&(Tok(m)!=END)) m++;
+                        if (Tok(m-1) == EOT) {    // ... and the ending too!
+                            LATCH(106,CODE_SET_B);
+                            i = (Tok(M+4)-'0')*10 + Tok(M+5)-'0';
+                            if ((Tok(M+6) == GS)&&(Tok(m-2) == RS)) {
+                                switch (i) {
+                                    case 05:
+                                        STOREDATUM(97);
+                                        break;
+                                    case 06:
+                                        STOREDATUM(98);
+                                        break;
+                                    case 12:
+                                        STOREDATUM(99);
+                                        break;
+                                    default:
+                                        break;
                                 }
-                                else {
-                                    BinAdd(258);
-                                    BinAdd(v>>16);
-                                    BinAdd((v>>8)&0xff);
-                                    BinAdd(v&0xff);
+                                if (PastFirstDatum) {
+                                    InsideMacro = 1;
+                                    M += 7;
                                 }
-                                M += 7;
-                                break;
                             }
-                            // or a candidate for continuing Binary mode...
-                            if ((!(FNCx(*M)))&&(((Binary(*M))||(Binary(*(M+1)))||(Binary(*(M+2)))||(Binary(*(M+3))))
-                                                ||((ECI(M+1,&v))&&(Binary(*(M+8)))))) {
-                                BinAdd(*(M++));
-                                break;
-                            }
-                            /* else Terminate */            BinFinish();
-                            if (*M != END) {
-                                /* a symbol separator? */       if (*M == FNC3) {
-                                    LATCH(112,CODE_SET_C);
-                                    break;
-                                }
-                                /* else A or B */                   if (AheadA(M) > AheadB(M)) LATCH(109,CODE_SET_A) else LATCH(110,CODE_SET_B);
-                                break;
+                            if (!PastFirstDatum) {
+                                STOREDATUM(100);
+                                STORE(i);
+                                InsideMacro = 2;
+                                M += 6;
                             }
+                        }
+                        if (InsideMacro) break;
+                    }
+                    // otherwise... always continue in C if at all possible
+                    if (nDigits(M) >= 2) {
+                        if (SeventeenTen(M)) {
+                            STOREDATUM(100);
+                            StoreC(M+2);
+                            StoreC(M+4);
+                            StoreC(M+6);
+                            M += 10;
+                        }
+                        else {
+                            StoreC(M);
+                            M += 2;
+                        }
+                        break;
+                    }
+                    if (Tok(M) == FNC1) {
+                        STORE(107);
+                        M++;
+                        break;
+                    }
+                    if (Tok(M) == FNC2) {
+                        M += StoreFNC2(M,&nshift);
+                        break;
+                    }
+                    if (Tok(M) == FNC3) {
+                        STORE(109);
+                        M++;
+                        break;
+                    }
+                    /* Check for Binary */      if (Tok(M) > 127) {
+                        if (DigitPair(M+1)) BinShift(Tok(M++));
+                        else LATCH(112,BINARY_MODE);
+                        break;
+                    }
+                    /* else to A or B */        if ((i = AheadA(M)) > (j = AheadB(M))) {
+                        LATCH(101,CODE_SET_A);    // to Codeset A
+                    }
+                    else {
+                        if (j <= 4) SHIFT(101+j,CODE_SET_B,j) else LATCH(106,CODE_SET_B);    // to Codeset B
+                    }
+                    break;
+
+                case BINARY_MODE:
+                    /* Check Code Set C */
+                    if ((i = TryC(M)) >= 2) {   // if "favorable",
+                        BinFinish();
+                        if (i <= 7) SHIFT(101+i,CODE_SET_C,i) else LATCH(111,CODE_SET_C);
+                        break;
+                    }
+                    /* Try Binary */                if ((ECI(M,&v))&&((Binary(Tok(M+7)))||(Tok(M+7) == END))) { // an ECI?...
+                        if (v < 256) {
+                            BinAdd(256);
+                            BinAdd(v);
+                        }
+                        else if (v < 65563) {
+                            BinAdd(257);
+                            BinAdd(v>>8);
+                            BinAdd(v&0xff);
+                        }
+                        else {
+                            BinAdd(258);
+                            BinAdd(v>>16);
+                            BinAdd((v>>8)&0xff);
+                            BinAdd(v&0xff);
+                        }
+                        M += 7;
+                        break;
+                    }
+                    // or a candidate for continuing Binary mode...
+                    if ((!(FNCx(Tok(M))))&&(((Binary(Tok(M)))||(Binary(Tok(M+1)))||(Binary(Tok(M+2)))||(Binary(Tok(M+3))))
+                                        ||((ECI(M+1,&v))&&(Binary(Tok(M+8)))))) {
+                        if ((nshift)||(binref)) BinAdd(Tok(M++));
+                        else M = BinRun(M);
+                        break;
+                    }
+                    /* else Terminate */            BinFinish();
+                    if (Tok(M) != END) {
+                        /* a symbol separator? */       if (Tok(M) == FNC3) {
+                            LATCH(112,CODE_SET_C);
                             break;
-
+                        }
+                        /* else A or B */                   if (AheadA(M) > AheadB(M)) LATCH(109,CODE_SET_A) else LATCH(110,CODE_SET_B);
+                        break;
                     }
-                }
-                while (repeat);
-                if (nshift) {
-                    nshift--;
-                    if (!nshift) mode = backto;
-                }
+                    break;
+
             }
-            if (mode == BINARY_MODE) BinFinish();
         }
-        free(Msg);
+        while (repeat);
+        if (nshift) {
+            nshift--;
+            if (!nshift) mode = backto;
+        }
     }
+    if (mode == BINARY_MODE) BinFinish();
     *cw = mode; // store final "mode" for possible padding
     return (cw - CW);
 }
 
+int FindDataWords (UCHAR *msg, int msglen, UCHAR *CW, int literal)
+{
+    tokens t;
+    int nd;
+    if (Tokenize(&t,msg,msglen,literal)) return (-1);
+    nd = EncodeTokens(&t,CW);
+    FreeTokens(&t);
+    return (nd);
+}
+
 static void AddPads (UCHAR *CW, int nd, int n)
 {
+    cw = CW+nd;
     if (*(CW+nd) == 3) {
         STORE(109);
         n--;
@@ -628,7 +930,11 @@ static void AddPads (UCHAR *CW, int nd, int n)
 /* ======================================================================== */
 
 // The 9-bit character patterns for the values 0 thru 102, plus a filler!
-static const int CharPats[113] = { // the 5-of-9 patterns with maximum transitions
+#if defined(__cplusplus)
+static constexpr int CharPats[113] = {
+#else
+static const int CharPats[113] = {
+#endif // the 5-of-9 patterns with maximum transitions
     0x155,0x0ab,0x0ad,0x0b5,0x0d5,0x156,0x15a,0x16a,0x1aa,0x0ae,
     0x0b6,0x0ba,0x0d6,0x0da,0x0ea,0x12b,0x12d,0x135,0x14b,0x14d,
     0x153,0x159,0x165,0x169,0x195,0x1a5,0x1a9,0x057,0x05b,0x05d,
@@ -642,406 +948,1225 @@ static const int CharPats[113] = { // the 5-of-9 patterns with maximum transitio
     0x079,0x08f,0x0c7,0x0e3,0x0f1,0x11e,0x13c,0x178,0x18e,0x19c,
     0x1b8,0x1c6,0x1cc,
 };
+#if defined(__cplusplus)
+constexpr bool PatsMatch ()
+{
+    for (int i=0; i<113; i++) if (CharPats[i] != dctab::pats[i]) return false;
+    return true;
+}
+static_assert(PatsMatch(), "CharPats[] must match the generated 5-of-9 patterns");
+#endif
 
-static void SetBit (output *out, int x, int y)
+const int *CharPatterns (void)
 {
-    unsigned char msk = 0x80 >> (x&7), *byte = BMAP + y * ((NCOL+7)>>3) + (x >> 3);
-    *byte |= msk;
+    return (CharPats);
 }
 
-static void NextDot (output *out, const int **wd, int *nw, int x, int y, int *pat, int *msk)
+/*-------------------------------------------------------------------------*/
+/*  The bitmap layout: "DotCodeLine(out)" returns the bytes from one row   */
+/*  (or column) to the next, "ViewDots(v,out)" resolves it all once, &     */
+/*  "DotAt(v,x,y,&bit)" locates a dot's byte & bit                         */
+/*-------------------------------------------------------------------------*/
+int DotCodeLine (output *out)
 {
-    if (*pat & *msk) SetBit(out,x,y);
-    *msk >>= 1;
-    if (!(*msk)) {
-        *msk = 0x100;
-        *pat = CharPats[*(++(*wd))];
-        (*nw)--;
-        if (*nw <= 0) *pat = 0x1ff;
-    }
+    int n = (out->layout & DOT_COLUMNS)? NROW : NCOL;
+    if (out->layout & DOT_PACKED) n = (n+1)>>1;
+    if (!(out->layout & DOT_BYTES)) n = (n+7)>>3;
+    if (out->stride > 0) return ((out->stride >= n)? out->stride : -1);
+    if (out->align > 1) n = ((n + out->align-1) / out->align) * out->align;
+    return (n);
 }
 
-static void LightAllCorners(output *out)
+int BitmapSize (output *out)
 {
-    if (NROW & 1) { // Odd symbol height
-        SetBit(out,NCOL-2,0);
-        SetBit(out,NCOL-2,NROW-1);
-        SetBit(out,NCOL-1,1);
-        SetBit(out,NCOL-1,NROW-2);
-        SetBit(out,0,0);
-        SetBit(out,0,NROW-1);
-    }
-    else {      // Even symbol height
-        SetBit(out,NCOL-1,NROW-2);
-        SetBit(out,0,NROW-2);
-        SetBit(out,NCOL-2,NROW-1);
-        SetBit(out,1,NROW-1);
-        SetBit(out,NCOL-1,0);
-        SetBit(out,0,0);
-    }
+    int line = DotCodeLine(out);
+    return ((line < 0)? -1 : line * ((out->layout & DOT_COLUMNS)? NCOL : NROW));
 }
 
-static void FillDotArray (output *out, const int *wd, int nw)
+void SetLayout (output *out, const options *opt)
 {
-    int x, y, pat = *wd, msk = 0x02;
-    memset(BMAP,0,sizeof(UCHAR) * NROW * ((NCOL+7)>>3));
-    if (NROW & 1) { // Odd symbol height
-        x = 0;
-        y = NROW-1;
-        do {
-            if ((((y>0)&&(y<NROW-1))||((x>0)&&(x<NCOL-2)))&&(((y>1)&&(y<NROW-2))||(x<NCOL-1))) {
-                NextDot(out,&wd,&nw,x,y,&pat,&msk);
-            }
-            x += 2;
-            if (x >= NCOL) x = (--y) & 1;
-        }
-        while (y >= 0);
-        NextDot(out,&wd,&nw,NCOL-2,0,&pat,&msk);
-        NextDot(out,&wd,&nw,NCOL-2,NROW-1,&pat,&msk);
-        NextDot(out,&wd,&nw,NCOL-1,1,&pat,&msk);
-        NextDot(out,&wd,&nw,NCOL-1,NROW-2,&pat,&msk);
-        NextDot(out,&wd,&nw,0,0,&pat,&msk);
-        NextDot(out,&wd,&nw,0,NROW-1,&pat,&msk);
-    }
-    else {      // Even symbol height
-        x = y = 0;
-        do {
-            if ((((x>0)&&(x<NCOL-1))||((y>0)&&(y<NROW-2)))&&(((x>1)&&(x<NCOL-2))||(y<NROW-1))) {
-                NextDot(out,&wd,&nw,x,y,&pat,&msk);
-            }
-            y += 2;
-            if (y >= NROW) y = (++x) & 1;
-        }
-        while (x < NCOL);
-        NextDot(out,&wd,&nw,NCOL-1,NROW-2,&pat,&msk);
-        NextDot(out,&wd,&nw,0,NROW-2,&pat,&msk);
-        NextDot(out,&wd,&nw,NCOL-2,NROW-1,&pat,&msk);
-        NextDot(out,&wd,&nw,1,NROW-1,&pat,&msk);
-        NextDot(out,&wd,&nw,NCOL-1,0,&pat,&msk);
-        NextDot(out,&wd,&nw,0,0,&pat,&msk);
-    }
+    out->layout = (opt)? opt->layout : 0;
+    out->stride = (opt)? opt->stride : 0;
+    out->align = (opt)? opt->align : 0;
 }
 
-int Printed (unsigned char *Dots, int Hgt, int Wid, int x, int y)
+int MessageMode (const options *opt)
 {
-    if ((x >= 0)&&(x < Wid)&&(y >= 0)&&(y < Hgt)) {
-        unsigned char mask = 0x80 >> (x&7);
-        unsigned char *byte = Dots + y * ((Wid+7)>>3) + (x>>3);
-        if (*byte & mask) return (1);
-    }
-    return (0);
+    return ((opt->gs1)? GS1_TOKENS : (opt->literal != 0));
 }
 
-int ClrCol (unsigned char *Dots, int Hgt, int Wid, int x)
+void ViewDots (dotview *v, output *out)
 {
-    int y;
-    for (y=x&1; y<Hgt; y+=2) if (Printed(Dots,Hgt,Wid,x,y)) return FALSE;
-    return TRUE;
+    v->bits = BMAP;
+    v->rows = NROW;
+    v->cols = NCOL;
+    v->line = DotCodeLine(out);
+    v->layout = out->layout;
 }
-int ClrRow (unsigned char *Dots, int Hgt, int Wid, int y)
+
+int DotAt (const dotview *v, int x, int y, UCHAR *bit)
 {
-    int x;
-    for (x=y&1; x<Wid; x+=2) if (Printed(Dots,Hgt,Wid,x,y)) return FALSE;
-    return TRUE;
+    int line = y, at = x;
+    if (v->layout & DOT_COLUMNS) {
+        line = x;
+        at = y;
+    }
+    if (v->layout & DOT_PACKED) at >>= 1;
+    if (v->layout & DOT_BYTES) {
+        *bit = 1;
+        return (line * v->line + at);
+    }
+    *bit = 0x80 >> (at&7);
+    return (line * v->line + (at >> 3));
 }
 
-// calc penalty for empty interior columns
-int ColPenalty (unsigned char *Dots, int Hgt, int Wid)
+int DotCodeDot (output *out, int x, int y)
 {
-    int x, penalty = 0, penalty_local = 0;
-    for (x=1; x<Wid-1; x++) {
-        if (ClrCol(Dots,Hgt,Wid,x)) {
-            if (penalty_local == 0) penalty_local = Hgt;
-            else penalty_local *= Hgt;
+    dotview v;
+    UCHAR bit;
+    if ((out->layout & DOT_PACKED)&&((x+y) & 1)) return (0);
+    ViewDots(&v,out);
+    return ((BMAP[DotAt(&v,x,y,&bit)] & bit)? 1:0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "DotCodeConvert(from,to,fill)" copies a symbol between layouts; rows   */
+/*  of bits are packed (& unpacked) a byte at a time, each byte's 4 dot    */
+/*  bits (7,5,3,1 or 6,4,2,0 by the row's parity) being a nibble packed    */
+/*-------------------------------------------------------------------------*/
+static THREAD_LOCAL UCHAR packbits[2][256], spreadbits[2][16];
+static THREAD_LOCAL int packready;
+
+static void PackTables (void)
+{
+    int b, k, p;
+    for (p=0; p<2; p++) {
+        for (b=0; b<256; b++) {
+            for (k=packbits[p][b]=0; k<4; k++) packbits[p][b] |= ((b >> (7-p-2*k)) & 1) << (3-k);
         }
-        else {
-            if (penalty_local) {
-                penalty += penalty_local;
-                penalty_local = 0;
-            }
+        for (b=0; b<16; b++) {
+            for (k=spreadbits[p][b]=0; k<4; k++) spreadbits[p][b] |= ((b >> (3-k)) & 1) << (7-p-2*k);
         }
     }
-    return penalty + penalty_local;
+    packready = 1;
 }
-// calc penalty for empty interior rows
-int RowPenalty (unsigned char *Dots, int Hgt, int Wid)
+
+int DotCodeConvert (output *from, output *to, int fill)
 {
-    int y, penalty = 0, penalty_local = 0;
-    for (y=1; y<Hgt-1; y++) {
-        if (ClrRow(Dots,Hgt,Wid,y)) {
-            if (penalty_local == 0) penalty_local = Wid;
-            else penalty_local *= Wid;
+    int x, y, i, n, b, nsrc, ndst, par;
+    dotview fv, tv;
+    UCHAR bit;
+
+    to->rows = from->rows;
+    to->cols = from->cols;
+    if (((n = BitmapSize(to)) < 0)||(BitmapSize(from) < 0)) return (-1);
+    if (!fill) return (n);
+
+    ViewDots(&fv,from);
+    ViewDots(&tv,to);
+    memset(to->bitmap,0,n);
+    if (!packready) PackTables();
+    if (((fv.layout|tv.layout) == DOT_PACKED)&&(fv.layout != tv.layout)) {
+        nsrc = (fv.layout)? (((from->cols+1)>>1)+7)>>3 : (from->cols+7)>>3;
+        ndst = (tv.layout)? (((to->cols+1)>>1)+7)>>3 : (to->cols+7)>>3;
+        for (y=0; y<from->rows; y++) {
+            const UCHAR *s = fv.bits + y * fv.line;
+            UCHAR *d = tv.bits + y * tv.line;
+            par = y & 1;
+            if (tv.layout) {    // pack two bytes into one
+                for (i=0; i<ndst; i++) {
+                    b = i<<1;
+                    d[i] = (UCHAR)((packbits[par][s[b]] << 4) | ((b+1 < nsrc)? packbits[par][s[b+1]] : 0));
+                }
+            }
+            else {              // unpack one byte into two
+                for (i=0; i<ndst; i++) {
+                    b = s[i>>1];
+                    d[i] = spreadbits[par][(i & 1)? (b & 0xf) : (b >> 4)];
+                }
+            }
         }
-        else {
-            if (penalty_local) {
-                penalty += penalty_local;
-                penalty_local = 0;
+        return (n);
+    }
+    for (y=0; y<from->rows; y++) {
+        for (x=y&1; x<from->cols; x+=2) {
+            if (Printed(&fv,x,y)) {
+                i = DotAt(&tv,x,y,&bit);
+                tv.bits[i] |= bit;
             }
         }
     }
-    return penalty + penalty_local;
+    return (n);
 }
 
-long ScoreArray (unsigned char *Dots, int Hgt, int Wid)
+static void SetBit (output *out, int x, int y)
 {
-    int x, y, worstedge, first, last, sum;
-    long penalty;
+    dotview v;
+    UCHAR msk;
+    ViewDots(&v,out);
+    BMAP[DotAt(&v,x,y,&msk)] |= msk;
+}
 
-    // first, guard against "pathelogical" gaps in the array
-    // subtract a penalty score for empty rows/columns from total code score for each mask,
-    // where the penalty is Sum(N ^ n), where N is the number of positions in a column/row,
-    // and n is the number of consecutive empty rows/columns (jHe, 2/24/2016)
-    penalty = RowPenalty(Dots, Hgt, Wid) + ColPenalty(Dots, Hgt, Wid);
-
-    // across the top edge, count printed dots and measure their extent
-    for (x=sum=0,first=last=-1; x<Wid; x+=2)    // REV 2.00 FIX
-        if (Printed(Dots,Hgt,Wid,x,0)) {
-            if (first<0) first = x;
-            last = x;
-            sum++;
+// the 6 corner dots, which are filled last & may be lit regardless
+static void Corners (int rows, int cols, short (*corner)[2])
+{
+    static const signed char odd[6][4] = {      // (x & y, as "cols"- & "rows"-)
+        {1,2,0,0}, {1,2,1,1}, {1,1,0,-1}, {1,1,1,2}, {0,0,0,0}, {0,0,1,1} };
+    static const signed char even[6][4] = {
+        {1,1,1,2}, {0,0,1,2}, {1,2,1,1}, {0,-1,1,1}, {1,1,0,0}, {0,0,0,0} };
+    const signed char (*c)[4] = (rows & 1)? odd : even;
+    int i;
+    for (i=0; i<6; i++) {
+        corner[i][0] = (short)(c[i][0] * cols - c[i][1]);
+        corner[i][1] = (short)(c[i][2] * rows - c[i][3]);
+    }
+}
+static void LightAllCorners(output *out)
+{
+    short corner[6][2];
+    int i;
+    Corners(NROW,NCOL,corner);
+    for (i=0; i<6; i++) SetBit(out,corner[i][0],corner[i][1]);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "BuildDotMap(map,out)" lists the dot positions of the symbol "out" (in */
+/*  its bitmap layout) in the order they are filled, unless "map" fits     */
+/*-------------------------------------------------------------------------*/
+static void Place (dotmap *map, const dotview *v, int x, int y)
+{
+    map->byte[map->ndots] = DotAt(v,x,y,map->bit+map->ndots);
+    map->x[map->ndots] = (unsigned short)x;
+    map->y[map->ndots] = (unsigned short)y;
+    map->ndots++;
+}
+
+int BuildDotMap (dotmap *map, output *out)
+{
+    int x, y, rows = NROW, cols = NCOL, n = ((rows * cols)>>1) + 8;
+    dotview v;
+
+    ViewDots(&v,out);
+    if (v.line < 0) return (-1);
+    if ((map->byte)&&(map->rows == rows)&&(map->cols == cols)&&(map->line == v.line)&&(map->layout == v.layout))
+        return (0);
+    FreeDotMap(map);
+    map->byte = (int*)DotAlloc(sizeof(int) * n);
+    map->bit = (UCHAR*)DotAlloc(sizeof(UCHAR) * n);
+    map->x = (unsigned short*)DotAlloc(sizeof(unsigned short) * n);
+    map->y = (unsigned short*)DotAlloc(sizeof(unsigned short) * n);
+    if ((!map->byte)||(!map->bit)||(!map->x)||(!map->y)) {
+        FreeDotMap(map);
+        return (-1);
+    }
+    map->rows = rows;
+    map->cols = cols;
+    map->line = v.line;
+    map->layout = v.layout;
+    map->size = BitmapSize(out);
+    if (rows & 1) { // Odd symbol height
+        x = 0;
+        y = rows-1;
+        do {
+            if ((((y>0)&&(y<rows-1))||((x>0)&&(x<cols-2)))&&(((y>1)&&(y<rows-2))||(x<cols-1))) {
+                Place(map,&v,x,y);
+            }
+            x += 2;
+            if (x >= cols) x = (--y) & 1;
+        }
+        while (y >= 0);
+        Place(map,&v,cols-2,0);
+        Place(map,&v,cols-2,rows-1);
+        Place(map,&v,cols-1,1);
+        Place(map,&v,cols-1,rows-2);
+        Place(map,&v,0,0);
+        Place(map,&v,0,rows-1);
+    }
+    else {      // Even symbol height
+        x = y = 0;
+        do {
+            if ((((x>0)&&(x<cols-1))||((y>0)&&(y<rows-2)))&&(((x>1)&&(x<cols-2))||(y<rows-1))) {
+                Place(map,&v,x,y);
+            }
+            y += 2;
+            if (y >= rows) y = (++x) & 1;
+        }
+        while (x < cols);
+        Place(map,&v,cols-1,rows-2);
+        Place(map,&v,0,rows-2);
+        Place(map,&v,cols-2,rows-1);
+        Place(map,&v,1,rows-1);
+        Place(map,&v,cols-1,0);
+        Place(map,&v,0,0);
+    }
+    return (0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "ThreadMap(out)" is this thread's own map for calls taking one symbol  */
+/*  at a time, rebuilt only when the size or layout changes; it's always   */
+/*  malloc()ed, as it outlives any DotCodeAllocator() scope, and freed by  */
+/*  "DotCodeThreadDone()" as the thread finishes                           */
+/*-------------------------------------------------------------------------*/
+static THREAD_LOCAL dotmap threadmap;
+
+dotmap *ThreadMap (output *out)
+{
+    const dotalloc *was = DotCodeAllocator(NULL);
+    int fail = BuildDotMap(&threadmap,out);
+    DotCodeAllocator(was);
+    return ((fail)? NULL : &threadmap);
+}
+
+void DotCodeThreadDone (void)
+{
+    const dotalloc *was = DotCodeAllocator(NULL);
+    FreeDotMap(&threadmap);
+    DotCodeAllocator(was);
+}
+
+void FreeDotMap (dotmap *map)
+{
+    DotFree(map->byte);
+    DotFree(map->bit);
+    DotFree(map->x);
+    DotFree(map->y);
+    DotFree(map->order);
+    DotFree(map->first);
+    memset(map,0,sizeof(dotmap));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "FillDotArray(out,map,wd,nw)" sets the dots for "nw" codewords, the    */
+/*  first (the mask) being 2 bits & the rest 9, then lights any leftovers  */
+/*-------------------------------------------------------------------------*/
+static void FillDotArray (output *out, const dotmap *map, const int *wd, int nw)
+{
+    int k = 0, n = map->ndots, pat, b;
+    const int *byte = map->byte;
+    const UCHAR *bit = map->bit;
+
+    memset(BMAP,0,sizeof(UCHAR) * map->size);
+    for (b=0x02; (b)&&(k<n); b>>=1,k++) if (*wd & b) BMAP[byte[k]] |= bit[k];
+    while ((--nw > 0)&&(k < n)) {
+        pat = CharPats[*(++wd)];
+        for (b=0x100; (b)&&(k<n); b>>=1,k++) if (pat & b) BMAP[byte[k]] |= bit[k];
+    }
+    for (; k<n; k++) BMAP[byte[k]] |= bit[k];
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "SortDots(map,scan)" orders the map's dots by column (or row) & then   */
+/*  down it (or across), by two counting sorts, once per symbol size       */
+/*-------------------------------------------------------------------------*/
+static int SortDots (dotmap *map, int scan)
+{
+    int i, k, n = map->ndots, nlines, npos, *count, *tmp;
+    const unsigned short *line = (scan)? map->y : map->x, *pos = (scan)? map->x : map->y;
+
+    if (map->scan == scan+1) return (0);
+    nlines = (scan)? map->rows : map->cols;
+    npos = (scan)? map->cols : map->rows;
+    DotFree(map->order);
+    DotFree(map->first);
+    map->scan = 0;
+    i = ((nlines > npos)? nlines : npos) + 1;
+    map->order = (int*)DotAlloc(sizeof(int) * n);
+    map->first = (int*)DotAlloc(sizeof(int) * (nlines+1));
+    count = (int*)DotAlloc(sizeof(int) * i);
+    tmp = (int*)DotAlloc(sizeof(int) * n);
+    if ((!map->order)||(!map->first)||(!count)||(!tmp)) {
+        DotFree(count);
+        DotFree(tmp);
+        return (-1);
+    }
+    memset(map->first,0,sizeof(int) * (nlines+1));
+    memset(count,0,sizeof(int) * i);
+    // first by position along the line, & then (stably) by line
+    for (k=0; k<n; k++) count[pos[k]+1]++;
+    for (i=0; i<npos; i++) count[i+1] += count[i];
+    for (k=0; k<n; k++) tmp[count[pos[k]]++] = k;
+    for (k=0; k<n; k++) map->first[line[k]+1]++;
+    for (i=0; i<nlines; i++) map->first[i+1] += map->first[i];
+    memcpy(count,map->first,sizeof(int) * nlines);
+    for (k=0; k<n; k++) map->order[count[line[tmp[k]]]++] = tmp[k];
+    DotFree(count);
+    DotFree(tmp);
+    map->scan = scan+1;
+    return (0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "FillListDots(out,map,wd,nw,corners,list)" is FillDotArray() (with the */
+/*  6 corners lit, if "corners") placing the dots in firing order instead, */
+/*  so that it lists each printed dot as it's placed                       */
+/*-------------------------------------------------------------------------*/
+static int FillListDots (output *out, dotmap *map, const int *wd, int nw, int corners, dotlist *list)
+{
+    int scan = list->scan & DOT_SCAN_Y, nlines, i, j, k, m = 0, lit, ndata = 2 + 9 * (nw-1);
+
+    if (SortDots(map,scan)) return (-1);
+    memset(BMAP,0,sizeof(UCHAR) * map->size);
+    nlines = (scan)? map->rows : map->cols;
+    for (i=0; i<nlines; i++) {
+        j = (list->scan & DOT_SCAN_REVERSE)? nlines-1-i : i;
+        if (list->line) list->line[i] = m;
+        for (k=map->first[j]; k<map->first[j+1]; k++) {
+            int d = map->order[k];
+            if (d < 2) lit = (wd[0] >> (1-d)) & 1;
+            else if (d < ndata) lit = (CharPats[wd[(d-2)/9+1]] >> (8-(d-2)%9)) & 1;
+            else lit = 1;   // (a leftover dot)
+            if ((corners)&&(d >= map->ndots-6)) lit = 1;
+            if (lit) {
+                BMAP[map->byte[d]] |= map->bit[d];
+                list->x[m] = map->x[d];
+                list->y[m] = map->y[d];
+                m++;
+            }
+        }
+    }
+    if (list->line) list->line[nlines] = m;
+    list->ndots = m;
+    return (0);
+}
+
+int Printed (const dotview *v, int x, int y)
+{
+    if ((x >= 0)&&(x < v->cols)&&(y >= 0)&&(y < v->rows)) {
+        UCHAR mask;
+        if (!v->layout) return ((v->bits[y * v->line + (x>>3)] >> (7-(x&7))) & 1);
+        if ((x+y) & 1) {
+            if (v->layout & DOT_PACKED) return (0);
+        }
+        else if (v->layout == DOT_PACKED) return ((v->bits[y * v->line + (x>>4)] >> (7-((x>>1)&7))) & 1);
+        if (v->bits[DotAt(v,x,y,&mask)] & mask) return (1);
+    }
+    return (0);
+}
+
+int ClrCol (const dotview *v, int x)
+{
+    int y;
+    for (y=x&1; y<v->rows; y+=2) if (Printed(v,x,y)) return FALSE;
+    return TRUE;
+}
+int ClrRow (const dotview *v, int y)
+{
+    int x;
+    for (x=y&1; x<v->cols; x+=2) if (Printed(v,x,y)) return FALSE;
+    return TRUE;
+}
+
+// calc penalty for empty interior columns (& the runs of them at either end)
+int ColPenalty (const dotview *v, int *run)
+{
+    int Hgt = v->rows, Wid = v->cols;
+    int x, penalty = 0, penalty_local = 0, k = 0, lead = -1;
+    for (x=1; x<Wid-1; x++) {
+        if (ClrCol(v,x)) {
+            if (penalty_local == 0) penalty_local = Hgt;
+            else penalty_local *= Hgt;
+            k++;
         }
-    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty top edge
-    worstedge = sum + last-first;
-    worstedge *= Hgt;
-
-    // across the bottom edge, ditto; REV 2.00 FIX
-    for (x=Wid&1,sum=0,first=last=-1; x<Wid; x+=2) 
-        if (Printed(Dots,Hgt,Wid,x,Hgt-1)) {
-            if (first<0) first = x;
-            last = x;
-            sum++;
+        else {
+            if (penalty_local) {
+                penalty += penalty_local;
+                penalty_local = 0;
+            }
+            if (lead < 0) lead = k;
+            k = 0;
+        }
+    }
+    run[0] = (lead < 0)? k : lead;
+    run[1] = k;
+    return penalty + penalty_local;
+}
+// calc penalty for empty interior rows (& the runs of them at either end)
+int RowPenalty (const dotview *v, int *run)
+{
+    int Hgt = v->rows, Wid = v->cols;
+    int y, penalty = 0, penalty_local = 0, k = 0, lead = -1;
+    for (y=1; y<Hgt-1; y++) {
+        if (ClrRow(v,y)) {
+            if (penalty_local == 0) penalty_local = Wid;
+            else penalty_local *= Wid;
+            k++;
         }
-    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty bottom edge
-    sum += last-first;
-    sum *= Hgt;
-    if (sum < worstedge) worstedge = sum;
-
-    // down the left edge, ditto; REV 2.00 FIX
-    for (y=sum=0,first=last=-1; y<Hgt; y+=2) 
-        if (Printed(Dots,Hgt,Wid,0,y)) {
-            if (first<0) first = y;
-            last = y;
-            sum++;
+        else {
+            if (penalty_local) {
+                penalty += penalty_local;
+                penalty_local = 0;
+            }
+            if (lead < 0) lead = k;
+            k = 0;
         }
-    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty left edge
-    sum += last-first;
-    sum *= Wid;
-    if (sum < worstedge) worstedge = sum;
-
-    // down the right edge, ditto; REV 2.00 FIX
-    for (y=Hgt&1,sum=0,first=last=-1; y<Hgt; y+=2) 
-        if (Printed(Dots,Hgt,Wid,Wid-1,y)) {
-            if (first<0) first = y;
-            last = y;
-            sum++;
+    }
+    run[0] = (lead < 0)? k : lead;
+    run[1] = k;
+    return penalty + penalty_local;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  The score is made of parts, so that lighting the 6 corner dots can be  */
+/*  rescored from them, by CornerScore(), only around those dots           */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    int sum[4], first[4], last[4];  // printed dots along the top, bottom, left & right edges
+    int rowpen, colpen;             // RowPenalty() & ColPenalty()...
+    int rowrun[2], colrun[2];       // ... & their runs of empty lines at either end
+    int cross;                      // # of cross patterns (& lone dots)
+} scoreparts;
+
+static int Cross (const dotview *v, int x, int y)
+{
+    return ((!Printed(v,x-1,y-1)) && (!Printed(v,x+1,y-1))
+            && (!Printed(v,x-1,y+1)) &&(!Printed(v,x+1,y+1))
+            && ((!Printed(v,x,y)) || ((!Printed(v,x-2,y))
+                    && (!Printed(v,x,y-2)) && (!Printed(v,x+2,y))
+                    && (!Printed(v,x,y+2)))
+               ));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "SampleCross(v)" estimates the cross patterns of a tall "v" from a     */
+/*  band of 2 rows (one of each parity) in each of SAMPLE_BANDS strata of  */
+/*  its rows, each count scaled up by its stratum's height; the bands lie  */
+/*  at fixed places, so all the candidate masks are sampled alike          */
+/*-------------------------------------------------------------------------*/
+#define SAMPLE_MIN   128    /* rows a symbol needs to be scored by sample */
+#define SAMPLE_BANDS 16     /* strata sampled */
+
+static int SampleCross (const dotview *v)
+{
+    int b, x, y, y0, h, k;
+    long sum = 0;
+    for (b=0; b<SAMPLE_BANDS; b++) {
+        y0 = (v->rows * b) / SAMPLE_BANDS;
+        h = (v->rows * (b+1)) / SAMPLE_BANDS - y0;
+        y0 += (int)((((unsigned int)b * 2654435761u) >> 16) % (unsigned int)(h-1));
+        if ((k = CrossCountRows(v,y0,y0+2)) < 0) {
+            for (y=y0,k=0; y<y0+2; y++) {
+                for (x=y&1; x<v->cols; x+=2) k += Cross(v,x,y);
+            }
+        }
+        sum += (long)k * h;
+    }
+    return ((int)((sum + 1) / 2));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "ScoreParts(v,sp,all,sample)" measures the edges, penalties & cross    */
+/*  patterns of "v" (the last by SampleCross(), if "sample"), returning 0  */
+/*  at once on finding an empty edge, unless "all"                         */
+/*-------------------------------------------------------------------------*/
+static int ScoreParts (const dotview *v, scoreparts *sp, int all, int sample)
+{
+    int Hgt = v->rows, Wid = v->cols;
+    int e, i, x, y, n, sum, first, last;
+
+    // along each edge (REV 2.00 FIX), count printed dots and measure their extent
+    for (e=0; e<4; e++) {
+        n = (e < 2)? Wid : Hgt;
+        i = (e & 1)? ((e < 2)? Wid : Hgt) & 1 : 0;
+        for (sum=0,first=last=-1; i<n; i+=2) {
+            x = (e < 2)? i : (e == 2)? 0 : Wid-1;
+            y = (e >= 2)? i : (e == 0)? 0 : Hgt-1;
+            if (Printed(v,x,y)) {
+                if (first<0) first = i;
+                last = i;
+                sum++;
+            }
         }
-    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty right edge
-    sum += last-first;
-    sum *= Wid;
-    if (sum < worstedge) worstedge = sum;
+        sp->sum[e] = sum;
+        sp->first[e] = first;
+        sp->last[e] = last;
+        if ((sum == 0)&&(!all)) return (0);     // guard against an empty edge
+    }
+
+    // guard against "pathelogical" gaps in the array
+    // subtract a penalty score for empty rows/columns from total code score for each mask,
+    // where the penalty is Sum(N ^ n), where N is the number of positions in a column/row,
+    // and n is the number of consecutive empty rows/columns (jHe, 2/24/2016)
+    sp->rowpen = RowPenalty(v,sp->rowrun);
+    sp->colpen = ColPenalty(v,sp->colrun);
 
     // throughout the array, count the # of unprinted 5-somes (cross patterns)
     // plus the # of printed dots surrounded by 8 unprinted neighbors
-    for (y=0,sum=0; y<Hgt; y++) {
-        for (x=y&1; x<Wid; x+=2) {
-            if ((!Printed(Dots,Hgt,Wid,x-1,y-1)) && (!Printed(Dots,Hgt,Wid,x+1,y-1))
-                    && (!Printed(Dots,Hgt,Wid,x-1,y+1)) &&(!Printed(Dots,Hgt,Wid,x+1,y+1))
-                    && ((!Printed(Dots,Hgt,Wid,x,y)) || ((!Printed(Dots,Hgt,Wid,x-2,y))
-                            && (!Printed(Dots,Hgt,Wid,x,y-2)) && (!Printed(Dots,Hgt,Wid,x+2,y))
-                            && (!Printed(Dots,Hgt,Wid,x,y+2)))
-                       )
-               ) sum++;
+    if (sample) sp->cross = SampleCross(v);
+    else if ((sp->cross = CrossCount(v)) < 0) {
+        for (y=0,sp->cross=0; y<Hgt; y++) {
+            for (x=y&1; x<Wid; x+=2) sp->cross += Cross(v,x,y);
         }
     }
+    return (1);
+}
 
-    return (worstedge - sum*sum - penalty);
+static long PartsScore (const dotview *v, const scoreparts *sp)
+{
+    int e, sum, worstedge = 0;
+    for (e=0; e<4; e++) {
+        if (sp->sum[e] == 0) return SCORE_UNLIT_EDGE;
+        sum = sp->sum[e] + sp->last[e]-sp->first[e];
+        sum *= (e < 2)? v->rows : v->cols;
+        if ((e == 0)||(sum < worstedge)) worstedge = sum;
+    }
+    return (worstedge - sp->cross*sp->cross - ((long)sp->rowpen + sp->colpen));
 }
 
-/* ======================================================================== */
-/* *************          GENERAL DOTCODE ENCODING          *************** */
-/* ======================================================================== */
+long ScoreArray (const dotview *v)
+{
+    scoreparts sp;
+    if (!ScoreParts(v,&sp,0,0)) return SCORE_UNLIT_EDGE;
+    return (PartsScore(v,&sp));
+}
 
-const int mask[4] = { 0, 3, 7, 17 };
+/*-------------------------------------------------------------------------*/
+/*  "CornerScore(v,sp,corner)" is the ScoreArray() of "v" (whose parts are */
+/*  "sp") with its 6 "corner" dots lit, found from the edges, penalties &  */
+/*  cross patterns they change alone                                       */
+/*-------------------------------------------------------------------------*/
+static int LitAt (const dotview *v, const short (*corner)[2], int x, int y)
+{
+    int i;
+    for (i=0; i<6; i++) if ((corner[i][0] == x)&&(corner[i][1] == y)) return (1);
+    return (Printed(v,x,y));
+}
 
-int DotCodeEncode (inputs *in, output *out, int literal, int topmsk, int fill, int show, int fast)
+static int LitCross (const dotview *v, const short (*corner)[2], int x, int y)
 {
-    // First, if not "literal", check that all #-sequences terminate legally
-    UCHAR *CW;
-    int i, nBytes = 0;
-    if (!literal) {
-        for (i=in->msglen,CW=in->msg; i>0; i--,CW++) {
-            if (*CW == '#') {
-                i--;
-                CW++;
-                if ((!i)||((*CW != '#')&&((*CW < '0')||(*CW >'3')))) return (-1);
+    return ((!LitAt(v,corner,x-1,y-1)) && (!LitAt(v,corner,x+1,y-1))
+            && (!LitAt(v,corner,x-1,y+1)) &&(!LitAt(v,corner,x+1,y+1))
+            && ((!LitAt(v,corner,x,y)) || ((!LitAt(v,corner,x-2,y))
+                    && (!LitAt(v,corner,x,y-2)) && (!LitAt(v,corner,x+2,y))
+                    && (!LitAt(v,corner,x,y+2)))
+               ));
+}
+
+// the penalty of a run of "n" empty lines "N" positions long, as summed above
+static unsigned int RunPenalty (int n, int N)
+{
+    unsigned int p = 0;
+    while (n-- > 0) p = (p)? p * N : (unsigned int)N;
+    return (p);
+}
+
+static int Unrun (int pen, const int *run, int nlines, int N, int f0, int f1)
+{
+    unsigned int p = (unsigned int)pen;
+    if (run[0] == nlines) return ((int)(p - RunPenalty(nlines,N) + RunPenalty(nlines-f0-f1,N)));
+    if (f0) p += RunPenalty(run[0]-1,N) - RunPenalty(run[0],N);
+    if (f1) p += RunPenalty(run[1]-1,N) - RunPenalty(run[1],N);
+    return ((int)p);
+}
+
+static long CornerScore (const dotview *v, const scoreparts *sp, const short (*corner)[2])
+{
+    int Hgt = v->rows, Wid = v->cols;
+    int i, j, e, k, x, y, cx, cy, fr[2] = {0,0}, fc[2] = {0,0}, done[6] = {0,0,0,0,0,0};
+    scoreparts lit = *sp;
+
+    for (i=0; i<6; i++) {
+        cx = corner[i][0];
+        cy = corner[i][1];
+        if (Printed(v,cx,cy)) continue;
+        for (j=0; (j<i)&&((corner[j][0] != cx)||(corner[j][1] != cy)); j++);
+        if (j < i) continue;
+
+        // its edges gain a dot (& maybe extent)...
+        for (e=0; e<4; e++) {
+            if ((e == 0)? (cy != 0) : (e == 1)? (cy != Hgt-1) : (e == 2)? (cx != 0) : (cx != Wid-1)) continue;
+            k = (e < 2)? cx : cy;
+            if ((lit.first[e] < 0)||(k < lit.first[e])) lit.first[e] = k;
+            if (k > lit.last[e]) lit.last[e] = k;
+            lit.sum[e]++;
+        }
+        // ... its line, if empty & at one end of the interior, no longer is...
+        if ((cy == 1)&&(sp->rowrun[0] > 0)) fr[0] = 1;
+        if ((cy == Hgt-2)&&(sp->rowrun[1] > 0)) fr[1] = 1;
+        if ((cx == 1)&&(sp->colrun[0] > 0)) fc[0] = 1;
+        if ((cx == Wid-2)&&(sp->colrun[1] > 0)) fc[1] = 1;
+
+        // ... & the cross patterns within its reach (once each) are recounted
+        for (y=cy-2; y<=cy+2; y++) {
+            if ((y < 0)||(y >= Hgt)) continue;
+            for (x=cx-2 + ((cx+y) & 1); x<=cx+2; x+=2) {
+                if ((x < 0)||(x >= Wid)) continue;
+                for (j=0; (j<i)&&((!done[j])||(abs(x-corner[j][0]) > 2)||(abs(y-corner[j][1]) > 2)); j++);
+                if (j < i) continue;
+                lit.cross += LitCross(v,corner,x,y) - Cross(v,x,y);
             }
         }
+        done[i] = 1;
     }
-    CW = (UCHAR*)malloc(sizeof(UCHAR) * (LEN<<4) + 4);
-    if (CW) {
-        int i, nd, nc, nw, minArea, hgt, wid;
-        UCHAR *cw = CW;
-        // First perform the Data Encoding
-        nd = FindDataWords(MSG,LEN,cw,literal);
-        nc = (nd>>1) + 3;
-        nw = nd + nc;
-        minArea = (2 + 9 * nw) << 1;
+    lit.rowpen = Unrun(sp->rowpen,sp->rowrun,Hgt-2,Wid,fr[0],fr[1]);
+    lit.colpen = Unrun(sp->colpen,sp->colrun,Wid-2,Hgt,fc[0],fc[1]);
+    return (PartsScore(v,&lit));
+}
 
-        if (show) {
-            printf("Message Chars: ");
-            for (i=0; i<nd; i++) printf(" %d",CW[i]);
-            printf("\n");
-            printf("  %d data + %d checks => Minimum # dots = %d\n",nd, nc, minArea>>1);
-        }
+/* ======================================================================== */
+/* *************          GENERAL DOTCODE ENCODING          *************** */
+/* ======================================================================== */
 
-        // Then find the symbol's size
-        if (HGT || WID) {
-            hgt = HGT;
-            wid = WID;
+const int mask[4] = { 0, 3, 7, 17 };
+
+THREAD_LOCAL UCHAR dw[MAXWD];       /* the data words, padded out to fill */
+
+/*-------------------------------------------------------------------------*/
+/*  "SymbolSize(nd,hgt,wid,out)" sizes a symbol for "nd" data words        */
+/*-------------------------------------------------------------------------*/
+int SymbolSize (int nd, int hgt, int wid, output *out)
+{
+    int nc, nw, minArea;
+    if (nd < 0) return (-1);
+    nc = (nd>>1) + 3;
+    nw = nd + nc;
+    minArea = (2 + 9 * nw) << 1;
+
+    if (!(hgt || wid)) {
+        hgt = 2;
+        wid = 3;
+    }
+    if (hgt) {
+        if (!wid) {
+            NROW = hgt;
+            NCOL = (minArea + NROW-1) / NROW;
+            if (!((NCOL^NROW)&0x1)) NCOL++;
+            while (NCOL < 7) NCOL += 2; // making sure NCOL >= 7 - padding will take care of the rest
         }
         else {
-            hgt = 2;
-            wid = 3;
-        }
-        if (hgt) {
-            if (!wid) {
-                NROW = hgt;
-                NCOL = (minArea + NROW-1) / NROW;
-                if (!((NCOL^NROW)&0x1)) NCOL++;
-                while (NCOL < 7) NCOL += 2; // making sure NCOL >= 7 - padding will take care of the rest
+            if (hgt * wid < 0) return (-1);
+            else if (hgt < 0) { // negative hgt & wid specifies symbol size!
+                if ((hgt + wid) & 1) {
+                    NROW = -hgt;
+                    NCOL = -wid;
+                }
+                else return (-1);
             }
             else {
-                if (hgt * wid < 0) return (-1);
-                else if (hgt < 0) { // negative hgt & wid specifies symbol size!
-                    if ((hgt + wid) & 1) {
-                        NROW = -hgt;
-                        NCOL = -wid;
+                float height = sqrt(minArea * hgt / wid), width = sqrt(minArea * wid / hgt);
+                NROW = (int)height;
+                NCOL = (int)width;
+                if ((NROW^NCOL) & 0x1) {    // already Odd vs. Even
+                    if ((NROW*NCOL) < minArea) {
+                        NROW++;
+                        NCOL++;
                     }
-                    else return (-1);
                 }
-                else {
-                    float height = sqrt(minArea * hgt / wid), width = sqrt(minArea * wid / hgt);
-                    NROW = (int)height;
-                    NCOL = (int)width;
-                    if ((NROW^NCOL) & 0x1) {    // already Odd vs. Even
+                else {      // either both Odd or both Even!
+                    if ((height * NCOL) < (width * NROW)) {
+                        NCOL++;
                         if ((NROW*NCOL) < minArea) {
+                            NCOL--;
                             NROW++;
-                            NCOL++;
                         }
+                        if ((NROW*NCOL) < minArea) NCOL += 2;
                     }
-                    else {      // either both Odd or both Even!
-                        if ((height * NCOL) < (width * NROW)) {
+                    else {
+                        NROW++;
+                        if ((NROW*NCOL) < minArea) {
+                            NROW--;
                             NCOL++;
-                            if ((NROW*NCOL) < minArea) {
-                                NCOL--;
-                                NROW++;
-                            }
-                            if ((NROW*NCOL) < minArea) NCOL += 2;
-                        }
-                        else {
-                            NROW++;
-                            if ((NROW*NCOL) < minArea) {
-                                NROW--;
-                                NCOL++;
-                            }
-                            if ((NROW*NCOL) < minArea) NROW += 2;
                         }
+                        if ((NROW*NCOL) < minArea) NROW += 2;
                     }
-                    while ((NROW < 7)||(NCOL < 7)) {
-                        NROW++;    // making sure NCOL & NROW both >= 7 - padding will take care of the rest
-                        NCOL++;
-                    }
+                }
+                while ((NROW < 7)||(NCOL < 7)) {
+                    NROW++;    // making sure NCOL & NROW both >= 7 - padding will take care of the rest
+                    NCOL++;
                 }
             }
         }
-        else {
-            NCOL = wid;
-            NROW = (minArea + NCOL-1) / NCOL;
-            if (!((NCOL^NROW)&0x1)) NROW++;
-            while (NROW < 7) NROW += 2; // making sure NROW >= 7 - padding will take care of the rest
+    }
+    else {
+        NCOL = wid;
+        NROW = (minArea + NCOL-1) / NCOL;
+        if (!((NCOL^NROW)&0x1)) NROW++;
+        while (NROW < 7) NROW += 2; // making sure NROW >= 7 - padding will take care of the rest
+    }
+
+    if ((nw * 9 + 2) > ((NROW * NCOL)>>1)) return (-1);  // in case hgt & wid are specified (both negative) but too small
+    if (((NROW * NCOL)>>1) / 9 >= MAXWD) return (-1);   // ... or too large for wd[]
+    return (BitmapSize(out));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "TraceEncoding(t)" has FillSymbol() time its stages into "t" (for the  */
+/*  DotCodeCompare() checker), between START() & STOP(stage)               */
+/*-------------------------------------------------------------------------*/
+static THREAD_LOCAL encodetrace *tracing;
+static THREAD_LOCAL long long started;
+
+#define START() { if (tracing) started = ClockNs(); }
+#define STOP(s) { if (tracing) tracing->ns[s] += ClockNs() - started; }
+
+void TraceEncoding (encodetrace *t)
+{
+    tracing = t;
+}
+
+encodetrace *Tracing (void)
+{
+    return (tracing);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "ListEncoding(list)" has FillSymbol() list the printed dots of the     */
+/*  symbols this thread fills into "list" (for DotCodeEncodeOptions())     */
+/*-------------------------------------------------------------------------*/
+static THREAD_LOCAL dotlist *listing;
+
+void ListEncoding (dotlist *list)
+{
+    listing = list;
+}
+
+dotlist *Listing (void)
+{
+    return (listing);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  R-S encoding is linear, so the check words of a masked symbol are the  */
+/*  checks of its unmasked data (mask word 0) plus those of the mask ramp  */
+/*  alone; "MaskChecks(msk,nd,nc)" keeps the latter for the last size      */
+/*-------------------------------------------------------------------------*/
+static THREAD_LOCAL UCHAR mchecks[4][MAXWD/3+2];
+static THREAD_LOCAL int mchecknd, mchecknc, mcheckset;
+
+static const UCHAR *MaskChecks (int msk, int nd, int nc)
+{
+    int i;
+    if ((mchecknd != nd)||(mchecknc != nc)) {
+        mchecknd = nd;
+        mchecknc = nc;
+        mcheckset = 1;      // (mask 0's ramp is all 0s, & so are its checks)
+        memset(mchecks[0],0,sizeof(UCHAR) * nc);
+    }
+    if (!(mcheckset & (1 << msk))) {    // each mask only once it's tried
+        wd[0] = msk;
+        for (i=0; i<nd-1; i++) wd[i+1] = RAMP(msk,i);
+        rsencode(nd,nc);
+        for (i=0; i<nc; i++) mchecks[msk][i] = (UCHAR)wd[nd+i];
+        mcheckset |= 1 << msk;
+    }
+    return (mchecks[msk]);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "MaskWords(msk,CW,chk,ND,NC)" sets wd[] to the "ND" data words of "CW" */
+/*  masked by "msk", & their check words from the unmasked checks "chk"    */
+/*-------------------------------------------------------------------------*/
+static void MaskWords (int msk, const UCHAR *CW, const UCHAR *chk, int ND, int NC)
+{
+    const UCHAR *mc = MaskChecks(msk,ND+1,NC);
+    int i, *w = wd + ND+1;
+    wd[0] = msk;
+    for (i=0; i<ND; i++) wd[i+1] = (CW[i] + RAMP(msk,i))%GF;
+    for (i=0; i<NC; i++) w[i] = (chk[i] + mc[i])%GF;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "SymbolWords(out,&ND,&NC)" returns the # of codewords "out" holds      */
+/*-------------------------------------------------------------------------*/
+int SymbolWords (output *out, int *nd, int *nc)
+{
+    int NW = (((NROW * NCOL)>>1) - 2) / 9;
+    if ((NW % 3) == 2) NW--;
+    *nc = (NW / 3) + 2;
+    *nd = NW - *nc;
+    return (NW);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "PadWords(CW,nd,ND)" pads the "nd" data words in "CW" out to "ND"      */
+/*-------------------------------------------------------------------------*/
+void PadWords (UCHAR *CW, int nd, int ND)
+{
+    if (ND > nd) AddPads(CW,nd,ND-nd); // REV 2.00 FIX
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "DOT_FAST_ADAPTIVE" tries first the masks that have most often won for */
+/*  this symbol size on this thread: "MaskOrder(out,fast,order)" sets the  */
+/*  trial order (3,2,1,0 unless adaptive), & "MaskWon(out,msk)" tallies    */
+/*-------------------------------------------------------------------------*/
+#define NTALLY 64       /* sizes remembered per thread (a power of 2) */
+#define TALLY_MAX 1024  /* tallies are halved here, so as to keep adapting */
+
+typedef struct {
+    int rows, cols;
+    int wins[4];
+} masktally;
+
+static THREAD_LOCAL masktally tallies[NTALLY];
+
+static masktally *Tally (output *out)
+{
+    masktally *t = tallies + ((NROW * 31 + NCOL) & (NTALLY-1));
+    if ((t->rows != NROW)||(t->cols != NCOL)) {
+        memset(t,0,sizeof(masktally));
+        t->rows = NROW;
+        t->cols = NCOL;
+    }
+    return (t);
+}
+
+static void MaskOrder (output *out, int fast, int *order)
+{
+    int i, j, m;
+    const int *wins;
+    for (i=0; i<4; i++) order[i] = 3-i;
+    if (fast != DOT_FAST_ADAPTIVE) return;
+    wins = Tally(out)->wins;
+    for (i=1; i<4; i++) {   // (a stable insertion sort, most wins first)
+        m = order[i];
+        for (j=i; (j>0)&&(wins[order[j-1]] < wins[m]); j--) order[j] = order[j-1];
+        order[j] = m;
+    }
+}
+
+static void MaskWon (output *out, int msk)
+{
+    masktally *t = Tally(out);
+    int i;
+    if (++t->wins[msk & 3] >= TALLY_MAX)
+        for (i=0; i<4; i++) t->wins[i] >>= 1;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Passes(v,corner,threshold)" scores the candidate in "v" (with its     */
+/*  "corner" dots lit, unless NULL) exactly, so that a sampled score must  */
+/*  truly beat the "fast" threshold to stop early                          */
+/*-------------------------------------------------------------------------*/
+static int Passes (const dotview *v, const short (*corner)[2], int threshold)
+{
+    scoreparts exact;
+    if (!corner) return (ScoreArray(v) > threshold);
+    ScoreParts(v,&exact,1,0);
+    return (CornerScore(v,&exact,corner) > threshold);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "PickMask(map,out,v,CW,chk,fast,sample,sel,&score)" fills & scores the */
+/*  candidate masks of "out" ("v"), returning the best & setting "score"   */
+/*  ("sample" estimating each one's cross patterns)                        */
+/*-------------------------------------------------------------------------*/
+static int PickMask (dotmap *map, output *out, const dotview *v, const UCHAR *CW, const UCHAR *chk,
+                     int fast, int sample, maskpick *sel, long *top)
+{
+    int t, ND, NC, NW, msk, topmsk = 0, order[4];
+    int threshold = (out->rows*out->cols)>>1;
+    long score, topscore = LONG_MIN, litscore[4];
+    short corner[6][2];
+    scoreparts parts;
+
+    NW = SymbolWords(out,&ND,&NC);
+    MaskOrder(out,fast,order);
+    Corners(NROW,NCOL,corner);
+    for (t=0; t<4; t++) {
+        msk = order[t];
+        START();
+        MaskWords(msk,CW,chk,ND,NC);
+        STOP(DOT_STAGE_RS);
+        START();
+        FillDotArray(out,map,wd,NW+1);
+        STOP(DOT_STAGE_FILL);
+
+        // (scored in parts, from which the corners lit are rescored)
+        START();
+        ScoreParts(v,&parts,1,sample);
+        score = PartsScore(v,&parts);
+        STOP(DOT_STAGE_SCORE);
+        sel->scored++;
+        if (score == SCORE_UNLIT_EDGE) sel->unlit++;
+        if (score > topscore) {
+            topscore = score;
+            topmsk = msk;
+
+            // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
+            if (fast) {
+                if ((topscore > threshold)&&((!sample)||(Passes(v,NULL,threshold))))
+                    break;
+            }
         }
-        if (show) printf("Symbol Size (HxW): %d x %d => ",NROW,NCOL);
-        nBytes = NROW * ((NCOL+7)>>3);
-
-        if ((nw * 9 + 2) > ((NROW * NCOL)>>1)) return (-1);  // in case hgt & wid are specified (both negative) but too small
-
-        if (fill) {
-            int NDOTS, ND, NC, NW, msk;
-            long score, topscore;
-            NDOTS = (NROW * NCOL)>>1;
-            NW = (NDOTS - 2) / 9;
-            if ((NW % 3) == 2) NW--;
-            NC = (NW / 3) + 2;
-            ND = NW - NC;
-            if (show) printf("Total # dots = %d\n",NDOTS);
-            if (ND > nd) AddPads(cw,nd,ND-nd); // REV 2.00 FIX
-
-            if (!TWIX(0,7,topmsk)) {
-                int threshold = (out->rows*out->cols)>>1;
-                topscore = LONG_MIN;
-                for (msk=3; msk>=0; msk--) {
-                    wd[0] = msk;
-                    for (i=0; i<ND; i++) wd[i+1] = (CW[i] + i*mask[msk])%GF;
-                    rsencode(ND+1,NC);
-                    FillDotArray(out,wd,NW+1);
-
-                    score = ScoreArray(out->bitmap,out->rows,out->cols);
-                    if (score > topscore) {
-                        topscore = score;
-                        topmsk = msk;
-
-                        // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
-                        if (fast) {
-                            if (topscore > threshold)
-                                break;
-                        }
-                    }
-                    if (fast) {
-                        LightAllCorners(out);
-                        score = ScoreArray(out->bitmap,out->rows,out->cols);
-                        if (score > topscore) {
-                            topscore = score;
-                            topmsk = msk + 4;
-
-                            // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
-                            if (topscore > threshold)
-                                break;
-                        }
-                    }
-                } // for loop over masks
-
-                if (!fast && topscore <= threshold) {
-                    for (msk=3; msk>=0; msk--) {
-                        wd[0] = msk;
-                        for (i=0; i<ND; i++) wd[i+1] = (CW[i] + i*mask[msk])%GF;
-                        rsencode(ND+1,NC);
-                        FillDotArray(out,wd,NW+1);
-                        LightAllCorners(out);
-
-                        score = ScoreArray(out->bitmap,out->rows,out->cols);
-                        if (score > topscore) {
-                            topscore = score;
-                            topmsk = msk + 4;
-                        }
-                    }
-                }
+        // the corners lit are only rescored to be compared: now if "fast",
+        // else below, & only if no mask passes (so while none has yet)
+        if ((fast)||(topscore <= threshold)) {
+            START();
+            litscore[msk] = CornerScore(v,&parts,(const short (*)[2])corner);
+            STOP(DOT_STAGE_SCORE);
+        }
+        if (fast) {
+            score = litscore[msk];
+            sel->scored++;
+            if (score == SCORE_UNLIT_EDGE) sel->unlit++;
+            if (score > topscore) {
+                topscore = score;
+                topmsk = msk + 4;
+
+                // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
+                if ((topscore > threshold)&&((!sample)||(Passes(v,(const short (*)[2])corner,threshold))))
+                    break;
             }
+        }
+    } // for loop over masks
+    sel->bypass = (fast)&&(t < 4);
+
+    if (!fast && topscore <= threshold) {
+        for (msk=3; msk>=0; msk--) {
+            score = litscore[msk];
+            sel->scored++;
+            if (score == SCORE_UNLIT_EDGE) sel->unlit++;
+            if (score > topscore) {
+                topscore = score;
+                topmsk = msk + 4;
+            }
+        }
+    }
+    *top = topscore;
+    return (topmsk);
+}
 
-            wd[0] = topmsk % 4;
-            for (i=0; i<ND; i++) wd[i+1] = (CW[i] + i*mask[topmsk % 4])%GF;
-            rsencode(ND+1,NC);
-            FillDotArray(out,wd,NW+1);
+/*-------------------------------------------------------------------------*/
+/*  "FillSymbol(map,out,CW,chk,...)" fills the sized symbol "out" with the */
+/*  padded data words in "CW", whose unmasked checks are "chk", choosing   */
+/*  the best mask unless "topmsk" dictates one (on sampled scores, that    */
+/*  chosen is scored exactly once filled, for the threshold & the error)   */
+/*-------------------------------------------------------------------------*/
+int FillSymbol (dotmap *map, output *out, const UCHAR *CW, const UCHAR *chk, int topmsk, int show, int fast)
+{
+    int i, ND, NC, NW, filled = 0, sample = (fast & DOT_FAST_SAMPLED)&&(NROW >= SAMPLE_MIN);
+    long score, topscore;
+    dotview view;
+    maskpick sel;
+
+    if (BuildDotMap(map,out)) return (-1);
+    ViewDots(&view,out);
+    NW = SymbolWords(out,&ND,&NC);
+    memset(&sel,0,sizeof(maskpick));
+    fast &= ~DOT_FAST_SAMPLED;
+
+    if (!TWIX(0,7,topmsk)) {
+        int threshold = (out->rows*out->cols)>>1;
+        sel.fast = fast;
+        topmsk = PickMask(map,out,&view,CW,chk,fast,sample,&sel,&topscore);
+        if (sample) {
+            START();
+            MaskWords(topmsk % 4,CW,chk,ND,NC);
+            STOP(DOT_STAGE_RS);
+            START();
+            if (listing) {
+                if (FillListDots(out,map,wd,NW+1,topmsk >= 4,listing)) return (-1);
+            }
+            else {
+                FillDotArray(out,map,wd,NW+1);
+                if (topmsk >= 4)
+                    LightAllCorners(out);
+            }
+            STOP(DOT_STAGE_FILL);
+            START();
+            score = ScoreArray(&view);
+            STOP(DOT_STAGE_SCORE);
+            sel.sampled = 1;
+            sel.error = (score > topscore)? score - topscore : topscore - score;
+            topscore = score;
+            filled = 1;
+        }
+        if (fast == DOT_FAST_ADAPTIVE) MaskWon(out,topmsk);
+        sel.margin = topscore - threshold;
+    }
+    sel.mask = topmsk;
+    CountFill(&sel);
+
+    if (!filled) {
+        START();
+        MaskWords(topmsk % 4,CW,chk,ND,NC);
+        STOP(DOT_STAGE_RS);
+        START();
+        if (listing) {
+            if (FillListDots(out,map,wd,NW+1,topmsk >= 4,listing)) return (-1);
+        }
+        else {
+            FillDotArray(out,map,wd,NW+1);
             if (topmsk >= 4)
                 LightAllCorners(out);
-            if (show) {
-                printf("\nFull Char Sequence: ");
-                for (i=0; i<ND+1; i++) printf(" %d",wd[i]);
-                printf(" |");
-                for (; i<NW+1; i++) printf(" %d",wd[i]);
-                printf("\nSelected Mask: %d  =>  Score = %ld\n",topmsk,ScoreArray(out->bitmap,out->rows,out->cols));
-            }
         }
-        free(CW);
+        STOP(DOT_STAGE_FILL);
+    }
+    if (tracing) {
+        tracing->mask = topmsk;
+        tracing->nw = NW+1;
+        memcpy(tracing->words,wd,sizeof(int) * (NW+1));
+    }
+    if (show) {
+        printf("\nFull Char Sequence: ");
+        for (i=0; i<ND+1; i++) printf(" %d",wd[i]);
+        printf(" |");
+        for (; i<NW+1; i++) printf(" %d",wd[i]);
+        printf("\nSelected Mask: %d  =>  Score = %ld\n",topmsk,ScoreArray(&view));
+    }
+    return (0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EncodeSymbol(map,out,CW,nd,...)" fills the sized symbol "out" with    */
+/*  the "nd" data words in "CW", choosing the best mask unless "topmsk"    */
+/*  dictates one; "map" is (re)built for this symbol size as needed        */
+/*-------------------------------------------------------------------------*/
+int EncodeSymbol (dotmap *map, output *out, UCHAR *CW, int nd, int topmsk, int show, int fast)
+{
+    int i, ND, NC;
+    UCHAR chk[MAXWD/3+2];
+
+    if (RefMode()) return (RefSymbol(out,CW,nd,topmsk,show,fast));
+    SymbolWords(out,&ND,&NC);
+    if (show) printf("Total # dots = %d\n",(NROW * NCOL)>>1);
+    memcpy(dw,CW,sizeof(UCHAR) * (nd+1));   // (the final mode, too)
+    PadWords(dw,nd,ND);
+
+    // the unmasked check words, from which every mask's are derived
+    START();
+    wd[0] = 0;
+    for (i=0; i<ND; i++) wd[i+1] = dw[i];
+    rsencode(ND+1,NC);
+    for (i=0; i<NC; i++) chk[i] = (UCHAR)wd[ND+1+i];
+    STOP(DOT_STAGE_RS);
+
+    return (FillSymbol(map,out,dw,chk,topmsk,show,fast));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EncodeSymbols(map,outs,CWs,nd,k,...)" encodes "k" symbols alike in    */
+/*  size, each of "nd" data words, their check words all computed at once  */
+/*  in R-S lanes (RSLANES at a time)                                       */
+/*-------------------------------------------------------------------------*/
+int EncodeSymbols (dotmap *map, output **outs, UCHAR **CWs, int nd, int k, int topmsk, int fast)
+{
+    int i, j, s, n, ND, NC, NW, fail = 0;
+    unsigned short *lanes;
+    UCHAR chk[MAXWD/3+2];
+
+    if (k < 1) return (0);
+    if (RefMode()) {
+        for (j=0; j<k; j++) if (EncodeSymbol(map,outs[j],CWs[j],nd,topmsk,0,fast)) fail = 1;
+        return ((fail)? -1:0);
+    }
+    NW = SymbolWords(outs[0],&ND,&NC);
+    lanes = (unsigned short*)DotAlloc(sizeof(unsigned short) * (NW+1) * RSLANES);
+    if (!lanes) return (-1);
+
+    for (s=0; s<k; s+=RSLANES) {
+        n = (k-s < RSLANES)? k-s : RSLANES;
+        memset(lanes,0,sizeof(unsigned short) * (ND+1) * RSLANES);
+        for (j=0; j<n; j++) {
+            memcpy(dw,CWs[s+j],sizeof(UCHAR) * (nd+1));
+            PadWords(dw,nd,ND);
+            for (i=0; i<ND; i++) lanes[(i+1)*RSLANES + j] = dw[i];
+        }
+        RsEncodeLanes(lanes,ND+1,NC);
+        for (j=0; (j<n); j++) {
+            for (i=0; i<ND; i++) dw[i] = (UCHAR)lanes[(i+1)*RSLANES + j];
+            for (i=0; i<NC; i++) chk[i] = (UCHAR)lanes[(ND+1+i)*RSLANES + j];
+            if (FillSymbol(map,outs[s+j],dw,chk,topmsk,0,fast)) fail = 1;
+        }
     }
+    DotFree(lanes);
+    return ((fail)? -1:0);
+}
+
+void DotCodeDefaults (options *opt)
+{
+    opt->literal = opt->gs1 = 0;
+    opt->topmsk = -1;
+    opt->fast = 0;
+    opt->layout = opt->stride = opt->align = 0;
+    opt->ecc = 0;
+    opt->dots = NULL;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EncodeMessage(tk,in,out,...)" encodes the tokenized message of "in"   */
+/*-------------------------------------------------------------------------*/
+static int EncodeMessage (const tokens *tk, inputs *in, output *out, int topmsk, int fill, int show, int fast, int ecc)
+{
+    UCHAR *CW = (UCHAR*)DotAlloc(sizeof(UCHAR) * (tk->n<<4) + 4);
+    int nBytes = -1;
+    if (CW) {
+        int i, nd, ne, nc;
+        // First perform the Data Encoding
+        nd = EncodeTokens(tk,CW);
+        ne = DotCodeEccWords(nd,ecc);   // (the data words it's sized for)
+        nc = (ne>>1) + 3;
+
+        if (show) {
+            printf("Message Chars: ");
+            for (i=0; i<nd; i++) printf(" %d",CW[i]);
+            printf("\n");
+            if (ne > nd) printf("  %d data (+ %d pad at ECC level %d)",nd,ne-nd,ecc);
+            else printf("  %d data",nd);
+            printf(" + %d checks => Minimum # dots = %d\n",nc, 2 + 9 * (ne + nc));
+        }
+
+        // Then find the symbol's size
+        nBytes = SymbolSize(ne,HGT,WID,out);
+        if ((show)&&(nBytes >= 0)) printf("Symbol Size (HxW): %d x %d => ",NROW,NCOL);
+
+        if ((fill)&&(nBytes >= 0)) {
+            dotmap map;
+            memset(&map,0,sizeof(dotmap));
+            if (EncodeSymbol(&map,out,CW,nd,topmsk,show,fast)) nBytes = -1;
+            FreeDotMap(&map);
+        }
+        DotFree(CW);
+    }
+    return (nBytes);
+}
+
+int DotCodeEncode (inputs *in, output *out, int literal, int topmsk, int fill, int show, int fast)
+{
+    // the "#"-sequences are checked as the message is tokenized
+    tokens tk;
+    int nBytes;
+    if (Tokenize(&tk,MSG,LEN,literal != 0)) return (-1);
+    SetLayout(out,NULL);    // (the bitmap is always in the default layout)
+    nBytes = EncodeMessage(&tk,in,out,topmsk,fill,show,fast,0);
+    FreeTokens(&tk);
+    return (nBytes);
+}
+
+int DotCodeEncodeEcc (inputs *in, output *out, int literal, int topmsk, int fill, int show, int fast, int ecc)
+{
+    tokens tk;
+    int nBytes;
+    if (!TWIX(0,DOT_ECC_LEVELS-1,ecc)) return (-1);
+    if (Tokenize(&tk,MSG,LEN,literal != 0)) return (-1);
+    SetLayout(out,NULL);
+    nBytes = EncodeMessage(&tk,in,out,topmsk,fill,show,fast,ecc);
+    FreeTokens(&tk);
+    return (nBytes);
+}
+
+int DotCodeEncodeOptions (inputs *in, output *out, const options *opt, int fill, int show)
+{
+    tokens tk;
+    int nBytes;
+    if (!TWIX(0,DOT_ECC_LEVELS-1,opt->ecc)) return (-1);
+    if (Tokenize(&tk,MSG,LEN,MessageMode(opt))) return (-1);
+    SetLayout(out,opt);
+    ListEncoding((fill)? opt->dots : NULL);
+    nBytes = EncodeMessage(&tk,in,out,opt->topmsk,fill,show,opt->fast,opt->ecc);
+    ListEncoding(NULL);
+    FreeTokens(&tk);
+    return (nBytes);
+}
+
+int DotCodeEncodeRaw (inputs *in, const fncmark *fncs, int nfnc, output *out, int topmsk, int fill, int fast)
+{
+    tokens tk;
+    int nBytes;
+    if (RawTokens(&tk,MSG,LEN,fncs,nfnc)) return (-1);
+    SetLayout(out,NULL);
+    nBytes = EncodeMessage(&tk,in,out,topmsk,fill,0,fast,0);
+    FreeTokens(&tk);
     return (nBytes);
 }
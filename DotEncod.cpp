@@ -0,0 +1,14 @@
+/* ======================================================================= */
+/**    "DotEncod.cpp" -- C++ build of the DotCode Encoding Module         **/
+/* ======================================================================= */
+
+// Build this file -instead of- DotEncod.c (never both) with a C++14 (or
+//  later) compiler to get the compile-time generated & checked tables of
+//  "DotTable.hpp".  The API keeps its C linkage, so the remaining modules &
+//  callers are unchanged, & the symbols produced are identical.
+
+#if !defined(__cplusplus) || (__cplusplus < 201402L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201402L))
+#error "DotEncod.cpp needs C++14 or later; build DotEncod.c instead"
+#endif
+
+#include "DotEncod.c"
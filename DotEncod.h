@@ -2,6 +2,9 @@
 /**	 "DotEncod.h" -- DotCode Encoding Module headers 10/21/08  (AL)	  **/
 /* ======================================================================= */
 
+#ifndef DOTENCOD_H
+#define DOTENCOD_H
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -30,9 +33,63 @@ typedef struct {
 	unsigned char *bitmap; /* a pointer to the Output Bitmap	*/
 	int cols;				/* # of bits per row	*/
 	int rows;				/* # of rows in the pattern	*/
+	int layout;				/* DOT_xxx flags, 0 for MSB-first bit rows	*/
+	int stride;				/* chars from row to row, 0 for the least	*/
+	int align;				/* ... or rounded up to a multiple of this	*/
 } output;
-// NOTE: each row of the bitmap is "(cols+7)/8" bytes padded with trailing
-//			"0"s, thus the size of "bitmap" in bytes is "(cols+7)/8 * rows"
+// NOTE: by default (all of "layout", "stride" & "align" 0) each row of the
+//			bitmap is "(cols+7)/8" bytes padded with trailing "0"s, thus the
+//			size of "bitmap" in bytes is "(cols+7)/8 * rows"
+//		"DOT_COLUMNS" stores it column by column instead (top dot first),
+//			& "DOT_BYTES" stores a char (0 or 1) per dot instead of a bit
+//		"DOT_PACKED" stores only the dot positions (where "x"+"y" is even),
+//			so that each row (column) holds "(cols+1)/2" ("(rows+1)/2") dots
+//		a "stride" > 0 fixes the chars from one row (column) to the next,
+//			else "align" > 1 rounds the least up to a multiple of it
+//		DotCodeEncode() & the like always give the default, while
+//			DotCodeEncodeOptions() & the other APIs taking "options" set
+//			the layout in "options"
+
+#define DOT_COLUMNS 1
+#define DOT_BYTES   2
+#define DOT_PACKED  4
+
+int DotCodeLine (output *out);
+int DotCodeDot (output *out, int x, int y);
+int DotCodeConvert (output *from, output *to, int fill);
+// Notes:
+//		DotCodeLine() returns the chars from one row (or column) of a sized
+//					"out" to the next, or -1 if "stride" is too short
+//		DotCodeDot() returns 1 if dot "x","y" of "out" is lit, else 0
+//		DotCodeConvert() sizes "to" like "from" (in its own layout) &, if
+//					"fill", copies the dots of the filled "from" into it,
+//					returning the size of the "to" bitmap in chars (or -1);
+//					packing & unpacking rows of bits is the fast case
+
+/*-------------------------------------------------------------------------*/
+/***************   SPARSE DOT LIST (PRINTHEAD FIRING ORDER)   ***************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int scan;				// DOT_SCAN_xxx: the printhead's direction of travel
+	unsigned short *x, *y;	// the printed dots, in firing order...
+	int *line;				// ... & where each line fired starts, or NULL
+	int ndots;				// # of dots listed
+} dotlist;
+// NOTE: when the "options" given DotCodeEncodeOptions() (with "fill") name
+//			a "dots" list, the filled symbol's printed dots are listed as
+//			they're placed, for a printhead travelling along X
+//			("DOT_SCAN_X": column by column, each from the top down) or Y
+//			("DOT_SCAN_Y": row by row, each from left to right), &
+//			"DOT_SCAN_REVERSE" reverses the direction of travel
+//		"x" & "y" need room for "(rows*cols)/2" dots, & "line" (unless
+//			NULL), for one index per column (or row) plus the final "ndots",
+//			so that the "i"th line fired (column or row "i", or when
+//			reversed, "cols-1-i" or "rows-1-i") fires dots "line[i]" thru
+//			"line[i+1]-1", the firing schedule of a line controller
+
+#define DOT_SCAN_X       0
+#define DOT_SCAN_Y       1
+#define DOT_SCAN_REVERSE 2
 
 /*-------------------------------------------------------------------------*/
 /*****************   PROTOTYPE OF THE ENCODING FUNCTION    *****************/
@@ -47,8 +104,455 @@ int DotCodeEncode (inputs *in, output *out, int literal, int topmsk, int fill, i
 //		"fill" determines if the symbol shall be filled or just "sized"
 //		"show" determines if symbol encoding details shall be output
 //					(generally for dignostic purposes only)
-//      "fast" allows short-circuiting if score is high enough
-//		DotCodeEncode() returns the size of the symbol bitmap in chars
+//      "fast" allows short-circuiting if score is high enough: 1 (or
+//					"DOT_FAST_FIXED") tries the masks in the fixed order 3,2,1,0,
+//					while "DOT_FAST_ADAPTIVE" tries first those that have most
+//					often won for the symbol's size on the calling thread (so
+//					its choice of mask is not reproducible, though just as good)
+//					& either may add "DOT_FAST_SAMPLED" (or it may be alone)
+//		DotCodeEncode() returns the size of the symbol bitmap in chars (in the
+//					"out" layout)
+
+#define DOT_FAST_FIXED    1
+#define DOT_FAST_ADAPTIVE 2
+#define DOT_FAST_SAMPLED  4
+// NOTE: "DOT_FAST_SAMPLED" scores the masks of a symbol of 128 rows or more
+//			approximately, counting its cross patterns in a band of 2 rows
+//			from each 16th of its rows (its edges & empty rows & columns
+//			still exactly), so each costs a fraction of the whole symbol;
+//			a "fast" selection only stops early once a candidate's exact
+//			score beats the threshold, (rows*cols)/2, & the mask chosen
+//			is always scored exactly, once
+//		DotCodeStats() reports how well the samples estimate
+
+// NOTE: a GS1 message (the "gs1" option, below) is one or more GS1 element
+//			strings, written "(AI)data(AI)data...", each AI of 2 to 4
+//			digits & its data in GS1's set of 82 characters (but for "(");
+//			it's encoded with FNC1 in first position & another ending
+//			each element string of variable length (but the last), the
+//			AIs whose length is predefined (00-04, 11-20, 31-36 & 41)
+//			needing none, but their data must then be that length
+//		an all-numeric message (as most are) whose runs of digits up to
+//			each FNC1 are even goes straight into Code Set C pairs,
+//			skipping the usual lookahead
+//		DotCodeDecode() reads it back "#"-escaped ("#1" for each FNC1)
+//		DotCodeEncodeSet() can't split it, & returns -1
+
+/*-------------------------------------------------------------------------*/
+/*****************   SIZE & CAPACITY QUERIES (NO ENCODING)   ***************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	short rows, cols;		// a legal symbol size...
+	short words;			// ... & the data codewords it holds
+} dotsize;
+
+int DotCodeWords (inputs *in, int literal);
+int DotCodeFit (int nd, int hgt, int wid, int *rows, int *cols);
+int DotCodeCapacity (int rows, int cols);
+int DotCodeSizes (int maxhgt, int maxwid, dotsize *sizes);
+// Notes:
+//		DotCodeWords() returns the # of data codewords the "in" message
+//					encodes to (its "hgt" & "wid" unused), or -1 if invalid
+//		DotCodeFit() sets the "rows" & "cols" DotCodeEncode() would choose
+//					for "nd" data codewords & the "hgt" & "wid" rules of
+//					"inputs", returning that size's capacity (as below), or
+//					-1 if no legal symbol results; so a message is counted
+//					once & then sized any number of ways in microseconds
+//		DotCodeCapacity() returns the most data codewords a "rows" x "cols"
+//					symbol holds, or -1 if that size is illegal
+//		DotCodeSizes() lists in "sizes" every legal size (from 5 x 5) up to
+//					"maxhgt" x "maxwid" that holds any data, in order of
+//					capacity (then of area), returning the # listed, just
+//					counting them when "sizes" is NULL
+
+#define DOT_SIZE_DOTS   0	// the fewest dot positions (then the squarest)
+#define DOT_SIZE_WIDTH  1	// the fewest columns (then the fewest dots)
+#define DOT_SIZE_HEIGHT 2	// the fewest rows (then the fewest dots)
+#define DOT_SIZE_ASPECT 3	// the nearest "hgt":"wid" (then the fewest dots)
+// NOTE: only sizes holding the data in the fewest columns for their height,
+//			& not in 2 fewer rows, are candidates, so even "DOT_SIZE_ASPECT"
+//			wastes no dots
+
+typedef struct {
+	int maxhgt, maxwid;		// the largest size allowed (0 for any)
+	int goal;				// DOT_SIZE_xxx
+	int hgt, wid;			// the aspect wanted by "DOT_SIZE_ASPECT"
+} sizegoal;
+
+int DotCodeOptimize (int nd, const sizegoal *g, int *rows, int *cols);
+// Notes:
+//		DotCodeOptimize() sets "rows" & "cols" to the legal size (rows+cols
+//					odd) within the "g" limits that best meets its goal &
+//					holds "nd" data codewords (by DotCodeCapacity(), & so
+//					as DotCodeEncode() packs them), returning its capacity,
+//					or -1 if none does (or "g" is illegal)
+//		it tries every height, in microseconds, & the size is then
+//					encoded as "hgt" = -"rows" & "wid" = -"cols"
+
+/*-------------------------------------------------------------------------*/
+/*****************   ERROR CORRECTION (ECC) LEVELS   ***********************/
+/*-------------------------------------------------------------------------*/
+#define DOT_ECC_LEVELS 5	// levels 0 (the least the spec allows) to 4
+
+int DotCodeEncodeEcc (inputs *in, output *out, int literal, int topmsk, int fill, int show, int fast, int ecc);
+int DotCodeEccWords (int nd, int ecc);
+int DotCodeEccCapacity (int rows, int cols, int ecc);
+// Notes:
+//		the spec fixes a symbol's check words at a third of its codewords
+//					(plus 2), so no level has fewer than DotCodeEncode()
+//					gives, level 0; each level above that sizes the symbol
+//					for 25% more data words (the extra being padding), so
+//					level 4 about doubles the check words protecting the
+//					message, in a symbol about twice the size
+//		DotCodeEncodeEcc() is DotCodeEncode() at level "ecc", returning -1
+//					also if "ecc" is out of range
+//		DotCodeEccWords() returns the data words "nd" are sized as at level
+//					"ecc" (so DotCodeFit() of it gives the symbol size)
+//		DotCodeEccCapacity() returns the most data codewords a "rows" x
+//					"cols" symbol holds at level "ecc", or -1 if illegal
+
+/*-------------------------------------------------------------------------*/
+/*******************   RAW BINARY MESSAGE ENCODING   **********************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int at;					// the message byte offset an FNC precedes...
+	int fnc;				// ... & which it is (1 to 3)
+} fncmark;
+
+int DotCodeEncodeRaw (inputs *in, const fncmark *fncs, int nfnc, output *out, int topmsk, int fill, int fast);
+// Notes:
+//		every byte of the "in" message is data (no "#x" sequences), & the
+//					"nfnc" FNCs are listed in "fncs" instead, in order of
+//					"at" (0 to "msglen"; an FNC2 followed by 6 digit bytes
+//					designates an ECI, just as "#2dddddd" does)
+//		otherwise as for DotCodeEncode(), returning -1 also if the list
+//					is out of order or names an illegal FNC
+
+/*-------------------------------------------------------------------------*/
+/*******************   ENCODING OPTIONS (BATCH APIs)   ********************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int literal;			// as for DotCodeEncode()
+	int gs1;				// non-zero for GS1 element strings (as above)
+	int topmsk;				// ditto (-1 picks the Best Mask)
+	int fast;				// ditto
+	int layout, stride, align;	// the bitmap layout, as for "output"
+	int ecc;				// the ECC level, as for DotCodeEncodeEcc()
+	dotlist *dots;			// if not NULL, receives the printed dots (above)
+} options;
+
+void DotCodeDefaults (options *opt);
+int DotCodeEncodeOptions (inputs *in, output *out, const options *opt, int fill, int show);
+int DotCodeWordsOptions (inputs *in, const options *opt);
+// Notes:
+//		"gs1" overrides "literal"
+//		DotCodeDefaults() sets "literal" & "gs1" 0, "topmsk" -1, "fast" 0, the
+//					default bitmap layout, "ecc" 0 & "dots" NULL
+//		DotCodeEncodeOptions() is DotCodeEncodeEcc() as "opt" sets, with
+//					the bitmap in the "opt" layout, & lists
+//					its dots in any "dots" list; the batch APIs below
+//					ignore "dots"
+//		DotCodeWordsOptions() is DotCodeWords() as "opt" sets
+
+/*-------------------------------------------------------------------------*/
+/*****************   SERIAL NUMBER RANGE GENERATOR MODE   *****************/
+/*-------------------------------------------------------------------------*/
+typedef int (*serialsink) (void *user, long serial, output *out, int nbytes);
+
+int DotCodeRange (inputs *in, int at, int digits, long first, long last,
+					options *opt, int threads, serialsink sink, void *user);
+// Notes:
+//		the "in" message is a template, & each serial "first" thru "last"
+//					is inserted at byte offset "at" (0 to "msglen") as
+//					decimal digits, zero padded to at least "digits" (0
+//					to 20) long
+//		"threads" worker threads encode the symbols (<= 1 encodes inline
+//					on the calling thread), but "sink" is always invoked on
+//					the calling thread & strictly in serial number order
+//		"sink" receives a filled "out" (in the "opt" layout), valid only
+//					until it returns, & returns non-zero to stop the run early
+//		the symbol size, dot placement & R-S generator are all reused
+//					from one serial to the next while the size holds
+//		DotCodeRange() returns the # of symbols delivered, or -1 if the
+//					template or the range can't be encoded
+
+/*-------------------------------------------------------------------------*/
+/***************   FNC3-LINKED MULTI-SYMBOL SET ENCODING   ****************/
+/*-------------------------------------------------------------------------*/
+int DotCodeEncodeSet (inputs *in, int maxhgt, int maxwid, output *outs, int *ends, int maxsyms,
+					options *opt, int threads, int fill);
+// Notes:
+//		the "in" message is split into a set of symbols, each no more than
+//					"maxhgt" rows high (exactly "maxhgt", when it's > 0) &
+//					"maxwid" columns wide (either may be 0 for no limit),
+//					every symbol but the last ending with an FNC3 linking it
+//					to the next; "in->hgt" & "in->wid" are not used
+//		"outs[i]" receives the size of each symbol, & "ends[i]" (unless
+//					NULL) the message offset where its piece ends; each
+//					piece fits, & the next legal end after it doesn't, but
+//					it's not always the longest that would fit (as a piece
+//					may take fewer codewords for being longer)
+//		"fill" works as for DotCodeEncode(): 0 just splits & sizes, so the
+//					"outs[i]" bitmaps can be allocated, & 1 also encodes them,
+//					on up to "threads" threads at once
+//		DotCodeEncodeSet() returns the # of symbols in the set, or -1 if
+//					the message won't fit in "maxsyms" symbols
+//		(a "literal" message has its "#"s escaped to add the FNC3s)
+
+/*-------------------------------------------------------------------------*/
+/****************   DECODING (FOR INLINE VERIFICATION)   ******************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int mask;				// the symbol's mask (0 to 3)
+	int nd, nc;				// # of data & check codewords
+	int erasures;			// # of codewords erased (unreadable patterns)...
+	int errors;				// ... & # of others found in error & corrected
+} decodeinfo;
+
+int DotCodeDecode (output *out, unsigned char *msg, int maxlen, int literal, decodeinfo *info);
+void DotCodeThreadDone (void);
+// Notes:
+//		the "out" bitmap is read back in the encoder's dot placement order,
+//					R-S corrected (erasing unreadable patterns, & then also
+//					any codewords under the 6 corner dots, which may have
+//					been lit), unmasked & translated back into "msg"
+//		"msg" receives the message as DotCodeEncode() takes it, "#"-escaped
+//					("##", "#0" for <NUL>, "#1"-"#3" & "#2dddddd" for an ECI)
+//					unless "literal", when any FNCx makes the decode fail
+//		"info" (unless NULL) receives the mask & the corrections made
+//		DotCodeDecode() returns the message length, or -1 if the symbol is
+//					uncorrectable or the message exceeds "maxlen" bytes
+//		(an FNC2 not introducing an ECI can't be read back unambiguously)
+//		DotCodeDecode() keeps the dot placement map of the last size it
+//					read, per thread, & DotCodeThreadDone() frees the
+//					calling thread's: call it before a thread of your own
+//					that has decoded exits (the library's threads do)
+
+/*-------------------------------------------------------------------------*/
+/*****************   PRINTER IMAGES & RASTER COMMANDS   *******************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int xdim;				// pixels per dot (>= 1)
+	int ucut;				// dot Undercut in pixels (0 to "xdim"-1)
+	int dots;				// non-zero for round dots, 0 for squares
+	int qzwid;				// quiet zone width in dots (3 is usual)
+} imaging;
+
+int DotCodeImage (output *out, const imaging *im, int *width, int *height);
+int DotCodeRaster (output *out, const imaging *im, int row, unsigned char *line);
+int DotCodeZPL (output *out, const imaging *im, int compress, char *cmd);
+int DotCodeEscPos (output *out, const imaging *im, unsigned char *cmd);
+// Notes:
+//		the filled "out" is imaged "xdim" pixels per dot, quiet zone
+//					included, as "width" x "height" pixels (1 bits print)
+//		DotCodeImage() returns the bytes in each pixel row (MSB first &
+//					padded with "0"s), or -1 if "im" is illegal
+//		DotCodeRaster() also stores pixel row "row" (0 is the top) in
+//					"line" (unless NULL), or returns -1 if it's off the image
+//		DotCodeZPL() stores a "^GFA,...^FS" graphic field in "cmd", its
+//					hex rows compressed (":", "," & "!" & G-z repeat
+//					counts) if "compress", to be placed by the caller's
+//					"^FO" within a label (no <NUL> is appended)
+//		DotCodeEscPos() stores a "GS v 0" raster bit image command in "cmd"
+//		both return the command length in chars, just sizing it when
+//					"cmd" is NULL, or -1 if "im" is illegal (or out of
+//					memory, or too large for "GS v 0")
+
+typedef struct dotscan dotscan;
+
+dotscan *DotCodeScanStart (output *out, const imaging *im, int up);
+int DotCodeScanLines (dotscan *s, unsigned char *rows, int n);
+void DotCodeScanStop (dotscan *s);
+// Notes:
+//		a scanner images "out" as DotCodeRaster() does, but a band of pixel
+//					rows at a time, top row first (or bottom row first if
+//					"up", as BMP files want), holding just 2 dot rows of
+//					its own, so a printer can take each band as it comes
+//		DotCodeScanStart() returns NULL if "im" is illegal (or out of memory)
+//		DotCodeScanLines() stores the next "n" (or fewer) pixel rows in "rows",
+//					one after the other, each of DotCodeImage() bytes, &
+//					returns how many, 0 once the image is done
+//		"out" must stay put until DotCodeScanStop() frees the scanner
+
+/*-------------------------------------------------------------------------*/
+/*******************   SHEET IMPOSITION (MANY PER PAGE)   ******************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int across, down;		// the grid: cells per row & rows of cells
+	int cellw, cellh;		// each cell's size in pixels (0 for the largest)
+	int gapx, gapy;			// pixels between cells...
+	int margin;				// ... & around the sheet
+} sheet;
+
+#define DOT_SHEET_BMP 0
+#define DOT_SHEET_PBM 1
+
+int DotCodeSheet (output *outs, int n, const imaging *im, const sheet *sh, int *width, int *height);
+int DotCodeSheetRows (output *outs, int n, const imaging *im, const sheet *sh, int row, int nrows, unsigned char *rows);
+int DotCodeSheetFile (output *outs, int n, const imaging *im, const sheet *sh, int format, const char *fname);
+// Notes:
+//		the "n" filled "outs" are imaged as for DotCodeImage() into the
+//					cells of a "width" x "height" pixel sheet, left to right
+//					& top to bottom, each image at the top left of its cell
+//					("outs[i].bitmap" NULL leaves cell "i" blank)
+//		DotCodeSheet() returns the bytes in each pixel row, or -1 if "im"
+//					or "sh" is illegal, "n" overfills the grid, or an image
+//					overflows its cell
+//		DotCodeSheetRows() stores sheet rows "row" thru "row+nrows-1" (0 is
+//					the top) in "rows", one after the other, so the sheet
+//					can be imaged in bands of any height, or all at once
+//		DotCodeSheetFile() writes the sheet to file "fname" as a BMP (1 bit,
+//					palette black-on-white) or a binary PBM ("P4"), imaging
+//					it in bands, & returns 0, or -1 if it fails
+
+/*-------------------------------------------------------------------------*/
+/*****************   NON-BLOCKING (ASYNCHRONOUS) ENCODING   ****************/
+/*-------------------------------------------------------------------------*/
+typedef struct encodequeue encodequeue;
+typedef struct encodejob encodejob;
+typedef void (*encodedone) (void *user, encodejob *job);
+
+#define DOT_QUEUED  0
+#define DOT_RUNNING 1
+#define DOT_DONE    2
+#define DOT_FAILED  3
+#define DOT_EXPIRED 4
+
+#define DOT_NORMAL  0
+#define DOT_URGENT  1
+
+encodequeue *DotCodeStartQueue (int threads, int depth);
+void DotCodeStopQueue (encodequeue *q);
+encodejob *DotCodeSubmit (encodequeue *q, inputs *in, options *opt, int priority,
+						  long long deadline, encodedone done, void *user);
+int DotCodeStatus (encodejob *job);
+output *DotCodeResult (encodejob *job, int *nbytes);
+void DotCodeRelease (encodejob *job);
+long long DotCodeClock (void);
+// Notes:
+//		DotCodeStartQueue() starts "threads" encoder threads (< 1 for one
+//					per CPU) fed by queues "depth" jobs deep, or returns NULL
+//		DotCodeStopQueue() lets every job already submitted finish (or
+//					expire), then stops the threads & frees the queue
+//		DotCodeSubmit() never blocks: it copies the "in" message, queues it
+//					to be encoded per "opt" (a "DOT_URGENT" "priority" ahead
+//					of all "DOT_NORMAL" work) & returns its job, or NULL if
+//					that queue is full; a job still waiting when its
+//					"deadline" passes (a DotCodeClock() time, 0 for none) is
+//					dropped as "DOT_EXPIRED" instead of encoded
+//		"done" (unless NULL) is called on an encoder thread once the job
+//					is "DOT_DONE", "DOT_FAILED" or "DOT_EXPIRED"
+//		DotCodeStatus() polls a job's DOT_xxx state
+//		DotCodeResult() returns a "DOT_DONE" job's filled symbol (its
+//					bitmap belonging to the job) & size, else NULL
+//		DotCodeRelease() must be called once per job, even unfinished,
+//					after which neither it nor its result may be used
+//		DotCodeClock() returns a monotonic time in milliseconds
+//		(DotAsync.hpp makes a job "co_await"able in C++20)
+
+/*-------------------------------------------------------------------------*/
+/*****************   MASK SELECTION COUNTERS (TELEMETRY)   *****************/
+/*-------------------------------------------------------------------------*/
+#define DOT_CANDIDATES 9
+#define DOT_MARGINS    16
+
+typedef struct {
+	long symbols;			// symbols filled (by any API, on any thread)...
+	long dictated;			// ... of which "topmsk" dictated the mask,
+	long fast;				// ... or were "fast" mask selections,
+	long bypass;			// ... of which stopped early, over threshold
+	long winners[8];		// symbols by mask filled (4-7 corners lit)
+	long scored;			// candidate fills scored in all...
+	long candidates[DOT_CANDIDATES];	// ... symbols by # scored (8 max)
+	long unlit;				// candidates scored as having an unlit edge
+	long sampled;			// selections scored by sample ("DOT_FAST_SAMPLED")...
+	long sampleerr;			// ... & the sum of their chosen scores' errors
+	long margins[DOT_MARGINS];	// symbols by best score over threshold
+} dotstats;
+
+void DotCodeStats (dotstats *s, int reset);
+// Notes:
+//		DotCodeStats() copies the process-wide counters into "s", & if
+//					"reset" also zeroes them (less anything counted meanwhile)
+//		"threshold" is the "fast" bypass threshold (rows*cols)/2, &
+//					"margins[0]" counts selections none of whose candidates
+//					beat it, "margins[k]" those beating it by 2^(k-1) up to
+//					2^k-1 (the last bin, by any more)
+//		"bypass" / "fast" is the "fast" hit rate, & "candidates" & "unlit"
+//					tell what a selection costs; dictated masks aren't scored
+//		"sampleerr" / "sampled" is the mean error of the sampled scores
+//					(the chosen candidate's, against its exact score), the
+//					"margins" of sampled selections being exact
+
+/*-------------------------------------------------------------------------*/
+/*****************   REFERENCE MODE & DIFFERENTIAL CHECKING   **************/
+/*-------------------------------------------------------------------------*/
+#define DOT_STAGE_DATA  0	// data codewords (the message encoding)
+#define DOT_STAGE_RS    1	// masking & R-S check words
+#define DOT_STAGE_FILL  2	// placing the dots
+#define DOT_STAGE_SCORE 3	// scoring the masks
+#define DOT_STAGES      4
+
+typedef struct {
+	long symbols;			// messages compared...
+	long differ;			// ... & how many differed at all,
+	long words, masks, bitmaps;	// ... in codewords, in mask, or in bitmap
+	long long optns[DOT_STAGES];	// nanoseconds per stage, optimized...
+	long long refns[DOT_STAGES];	// ... & reference
+} diffreport;
+
+int DotCodeReference (int on);
+int DotCodeCompare (inputs *in, options *opt, diffreport *rep);
+// Notes:
+//		DotCodeReference() switches every encoder (on all threads) to the
+//					reference (rev 2.24) symbol encoding if "on", or back
+//					to the optimized one, returning the previous setting; the
+//					symbols are the same either way, only slower
+//		DotCodeCompare() encodes the "in" message per "opt" both ways &
+//					adds the outcome & the time taken in each stage to "rep"
+//					(zero it to begin), returning 0 if the codewords, mask
+//					& bitmap all match, 1 if not, or -1 if it can't be
+//					encoded
+
+/*-------------------------------------------------------------------------*/
+/*****************   RUN-TIME CPU DISPATCH   *******************************/
+/*-------------------------------------------------------------------------*/
+#define DOT_CPU_SCALAR 0	// plain C
+#define DOT_CPU_SSE2   1	// R-S lanes 8 at a time
+#define DOT_CPU_SSE42  2	// ... & the POPCNT instruction for scoring
+#define DOT_CPU_AVX2   3	// ... & R-S lanes 16 at a time
+
+int DotCodeCpu (void);
+// Notes:
+//		DotCodeCpu() returns the DOT_CPU_xxx level of the kernels in use,
+//					the best this CPU supports (& the compiler builds: no
+//					AVX2 before Visual C++ 2012, nor SSE4.2 before 2008),
+//					found by cpuid at first use;
+//					the environment variable DOTCODE_CPU ("scalar", "sse2",
+//					"sse4.2" or "avx2") caps it, for testing the others
+//		(the symbols are the same at every level, only faster)
+
+/*-------------------------------------------------------------------------*/
+/*****************   SCRATCH MEMORY ALLOCATOR   ****************************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	void *(*alloc) (void *user, int n);				// returns "n" chars (or NULL)
+	void (*release) (void *user, void *p, int n);	// returns them
+	void *user;
+} dotalloc;
+
+const dotalloc *DotCodeAllocator (const dotalloc *a);
+// Notes:
+//		DotCodeAllocator() has the encodings made on the calling thread take
+//					their scratch memory (tokens, codewords & dot maps) from
+//					"a" instead of malloc() (NULL for malloc() again), & returns
+//					the allocator it replaces; "a" must stay valid until all
+//					it allocated is released, which may be on another thread
+//		blocks must be aligned as malloc()'s are, & "release" is told the
+//					"n" each was allocated with
+//		(worker threads started by the batch APIs still use malloc(), as
+//					do the bitmaps, which the caller allocates; DotCode.hpp
+//					wraps this for a C++17 "std::pmr::memory_resource")
 
 /*-------------------------------------------------------------------------*/
 /*********   HANDY MACROS REFERRING TO INPUT & OUTPUT VARIABLES    *********/
@@ -65,3 +569,5 @@ int DotCodeEncode (inputs *in, output *out, int literal, int topmsk, int fill, i
 #if defined(__cplusplus)
 }
 #endif
+
+#endif
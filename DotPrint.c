@@ -0,0 +1,493 @@
+/* ======================================================================= */
+/**  "DotPrint.c" -- DotCode printer images: rasters, ZPL & ESC/POS      **/
+/* ======================================================================= */
+
+// The symbol is imaged exactly as the sample BMP always was: each dot is
+//  "xdim" pixels square, trimmed by the "ucut" undercut along its top &
+//  right edges (squares keeping contact with lit neighbours, round dots
+//  rounded off), inside a "qzwid" dot quiet zone.  DotCodeRaster() returns
+//  that image one pixel row at a time, top row first & 1 bits printed, &
+//  the command emitters wrap those rows straight into ZPL "^GF" or ESC/POS
+//  "GS v 0" raster graphics, with no intermediate image file, or a scanner
+//  (DotCodeScanStart()) returns them a band at a time.  A sheet of
+//  symbols is imaged the same way, a band of pixel rows at a time across
+//  every symbol in it, so a page never needs to be held whole.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+
+#define UCHAR unsigned char
+
+/*-------------------------------------------------------------------------*/
+/*  "RenderAt(v,im,row,line,x0)" images pixel row "row" into "line", its   */
+/*  left edge at pixel "x0" (only setting bits), & "Render(...,nbytes)"    */
+/*  images it into a cleared "line"                                        */
+/*-------------------------------------------------------------------------*/
+static void RenderAt (const dotview *v, const imaging *im, int row, UCHAR *line, int x0)
+{
+    int xdim = im->xdim, full = xdim - im->ucut;
+    int i, j, k, l, x, obt, ebit, sbit, sebit, xdis, ydis;
+
+    row -= im->qzwid * xdim;
+    if ((row < 0)||(row >= v->rows * xdim)) return;     // quiet zone
+    i = row / xdim;
+    j = xdim-1 - (row % xdim);     // pixels up from the dot's bottom edge
+    ydis = (j<<1) - (full-1);
+    if (ydis < 0) ydis = -ydis;
+
+    for (k=0,x=x0+im->qzwid*xdim; k<v->cols; k++) {
+        obt = Printed(v,k,i);
+        if (!obt) {
+            x += xdim;
+            continue;
+        }
+        ebit = Printed(v,k+1,i);
+        sbit = Printed(v,k,i-1);
+        sebit = Printed(v,k+1,i-1);
+        for (l=0; l<xdim; l++,x++) {
+            xdis = (l<<1) - (full-1);
+            if (xdis < 0) xdis = -xdis;
+            if (im->dots) {
+                if ((l >= full)||(j >= full)) continue;
+                if ((xdis+ydis) > full*4/3) continue;
+            }
+            else {
+                /*** (This fancy conditional preserves the bullseye intact!) ***/
+                if (((l >= full)&&(!ebit))||((j >= full)&&(!sbit))||((l >= full)&&(j >= full)&&(!sebit))) continue;
+            }
+            line[x>>3] |= 0x80 >> (x&7);
+        }
+    }
+}
+
+static void Render (const dotview *v, const imaging *im, int row, UCHAR *line, int nbytes)
+{
+    memset(line,0,nbytes);
+    RenderAt(v,im,row,line,0);
+}
+
+/* ======================================================================= */
+/* *********************      RASTER IMAGING      ********************** */
+/* ======================================================================= */
+
+int DotCodeImage (output *out, const imaging *im, int *width, int *height)
+{
+    int w, h;
+    if ((im->xdim < 1)||(im->ucut < 0)||(im->ucut >= im->xdim)||(im->qzwid < 0)) return (-1);
+    if (DotCodeLine(out) < 0) return (-1);
+    w = (NCOL + (im->qzwid<<1)) * im->xdim;
+    h = (NROW + (im->qzwid<<1)) * im->xdim;
+    if (width) *width = w;
+    if (height) *height = h;
+    return ((w+7)>>3);
+}
+
+int DotCodeRaster (output *out, const imaging *im, int row, UCHAR *line)
+{
+    int h, nbytes = DotCodeImage(out,im,NULL,&h);
+    dotview v;
+    if ((nbytes < 0)||(row < 0)||(row >= h)) return (-1);
+    if (line) {
+        ViewDots(&v,out);
+        Render(&v,im,row,line,nbytes);
+    }
+    return (nbytes);
+}
+
+/* ======================================================================= */
+/* *******************      BANDED SCANLINES      ********************** */
+/* ======================================================================= */
+
+// A scanner images the symbol a band at a time, in either direction, by the
+//  same rules as RenderAt(), but keeps just the 2 dot rows a pixel row needs
+//  (its own & the one above) unpacked, one char per dot, & sets each dot's
+//  pixels as a single run.  Stepping on a dot row reuses the one it shares.
+
+struct dotscan {
+    dotview v;
+    imaging im;
+    int height, nbytes;
+    int next, step;         // the next pixel row, & +1 (down) or -1 (up)
+    int row;                // the dot row in "cur" (-2 before any)
+    UCHAR *cur, *above;     // its printed dots & those above ("cols"+1 each)
+};
+
+/*-------------------------------------------------------------------------*/
+/*  "LoadRow(s,i,dots)" unpacks dot row "i" (off the symbol unlit), & the  */
+/*  0 past its right end                                                   */
+/*-------------------------------------------------------------------------*/
+static void LoadRow (dotscan *s, int i, UCHAR *dots)
+{
+    int k;
+    for (k=0; k<s->v.cols; k++) dots[k] = (UCHAR)Printed(&s->v,k,i);
+    dots[k] = 0;
+}
+
+static void NeedRow (dotscan *s, int i)
+{
+    UCHAR *t;
+    if (i == s->row) return;
+    if (i == s->row + 1) {      // going down: the old row is now above
+        t = s->above;
+        s->above = s->cur;
+        s->cur = t;
+        LoadRow(s,i,s->cur);
+    }
+    else if (i == s->row - 1) {     // going up: the old row above is now it
+        t = s->cur;
+        s->cur = s->above;
+        s->above = t;
+        LoadRow(s,i-1,s->above);
+    }
+    else {
+        LoadRow(s,i,s->cur);
+        LoadRow(s,i-1,s->above);
+    }
+    s->row = i;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "SetRun(line,x,n)" sets the "n" pixels from pixel "x" on               */
+/*-------------------------------------------------------------------------*/
+static void SetRun (UCHAR *line, int x, int n)
+{
+    int b = x>>3, e = x + n;
+    if (n <= 0) return;
+    if (b == ((e-1)>>3)) {
+        line[b] |= (0xff >> (x&7)) & (0xff << ((-e)&7));
+        return;
+    }
+    line[b++] |= 0xff >> (x&7);
+    for (; b<(e>>3); b++) line[b] = 0xff;
+    if (e&7) line[b] |= 0xff << (8-(e&7));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "ScanRow(s,row,line)" images pixel row "row" into "line": each lit dot */
+/*  sets pixels "lo" to "hi"-1 of its own, squares reaching into the next  */
+/*  dot when it's lit too (& below "full", the dots above are lit)         */
+/*-------------------------------------------------------------------------*/
+static void ScanRow (dotscan *s, int row, UCHAR *line)
+{
+    int xdim = s->im.xdim, full = xdim - s->im.ucut;
+    int i, j, k, l, x, lo, hi, ydis;
+
+    memset(line,0,s->nbytes);
+    row -= s->im.qzwid * xdim;
+    if ((row < 0)||(row >= s->v.rows * xdim)) return;      // quiet zone
+    i = row / xdim;
+    j = xdim-1 - (row % xdim);     // pixels up from the dot's bottom edge
+    NeedRow(s,i);
+    x = s->im.qzwid * xdim;
+
+    if (s->im.dots) {
+        if (j >= full) return;
+        ydis = (j<<1) - (full-1);
+        if (ydis < 0) ydis = -ydis;
+        // (the pixels within the diamond, "full*4/3" from the dot's centre)
+        for (lo=0; (lo<full)&&(abs((lo<<1) - (full-1)) + ydis > full*4/3); lo++);
+        for (hi=lo; (hi<full)&&(abs((hi<<1) - (full-1)) + ydis <= full*4/3); hi++);
+        for (k=0; k<s->v.cols; k++,x+=xdim) {
+            if (s->cur[k]) SetRun(line,x+lo,hi-lo);
+        }
+        return;
+    }
+    for (k=0; k<s->v.cols; k++,x+=xdim) {
+        if (!s->cur[k]) continue;
+        if (j < full) l = (s->cur[k+1])? xdim : full;
+        else if (!s->above[k]) continue;
+        else l = ((s->cur[k+1])&&(s->above[k+1]))? xdim : full;
+        SetRun(line,x,l);
+    }
+}
+
+dotscan *DotCodeScanStart (output *out, const imaging *im, int up)
+{
+    dotscan *s;
+    int nbytes = DotCodeImage(out,im,NULL,NULL);
+
+    if (nbytes < 0) return (NULL);
+    s = (dotscan*)calloc(1,sizeof(dotscan) + ((NCOL+1)<<1));
+    if (!s) return (NULL);
+    ViewDots(&s->v,out);
+    s->im = *im;
+    s->nbytes = nbytes;
+    DotCodeImage(out,im,NULL,&s->height);
+    s->step = (up)? -1 : 1;
+    s->next = (up)? s->height-1 : 0;
+    s->row = -2;
+    s->cur = (UCHAR*)(s+1);
+    s->above = s->cur + NCOL+1;
+    return (s);
+}
+
+int DotCodeScanLines (dotscan *s, UCHAR *rows, int n)
+{
+    int r;
+    for (r=0; (r<n)&&(s->next >= 0)&&(s->next < s->height); r++,s->next+=s->step) {
+        ScanRow(s,s->next,rows + r * s->nbytes);
+    }
+    return (r);
+}
+
+void DotCodeScanStop (dotscan *s)
+{
+    free(s);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  A command being emitted: "cmd" (or NULL when only sizing) & its length */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    UCHAR *cmd;
+    int n;
+} emitter;
+
+static void Emit (emitter *e, int c)
+{
+    if (e->cmd) e->cmd[e->n] = (UCHAR)c;
+    e->n++;
+}
+
+static void EmitText (emitter *e, const char *s)
+{
+    while (*s) Emit(e,*s++);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EmitRun(e,hex,n)" emits "n" repeats of digit "hex" in the ZPL         */
+/*  compressed form: counts of G-Y (1-19) & g-z (20-400) before the digit  */
+/*-------------------------------------------------------------------------*/
+static void EmitRun (emitter *e, int hex, int n)
+{
+    int k;
+    while (n > 0) {
+        k = (n > 419)? 419 : n;
+        n -= k;
+        if (k >= 20) Emit(e,'g' + (k/20) - 1);
+        if ((k % 20)&&(k > 1)) Emit(e,'G' + (k%20) - 1);
+        Emit(e,hex);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EmitHexRow(e,line,prev,nbytes,compress)" emits one row of "^GFA"      */
+/*  data, compressed (against the "prev" row, if any) when "compress"      */
+/*-------------------------------------------------------------------------*/
+static void EmitHexRow (emitter *e, const UCHAR *line, const UCHAR *prev, int nbytes, int compress)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    int i, k, d, n = nbytes<<1;
+
+    if (!compress) {
+        for (i=0; i<nbytes; i++) {
+            Emit(e,hex[line[i]>>4]);
+            Emit(e,hex[line[i]&0xf]);
+        }
+        return;
+    }
+    if ((prev)&&(!memcmp(line,prev,nbytes))) {
+        Emit(e,':');     // a repeat of the row above
+        return;
+    }
+    for (i=0; i<n; i=k) {
+        d = (i&1)? (line[i>>1]&0xf) : (line[i>>1]>>4);
+        for (k=i+1; (k<n)&&(((k&1)? (line[k>>1]&0xf) : (line[k>>1]>>4)) == d); k++);
+        if ((k == n)&&(d == 0)) Emit(e,',');                // 0s to the row's end
+        else if ((k == n)&&(d == 0xf)) Emit(e,'!');         // 1s to the row's end
+        else EmitRun(e,hex[d],k-i);
+    }
+}
+
+/* ======================================================================= */
+/* *******************      PRINTER COMMANDS      ********************** */
+/* ======================================================================= */
+
+int DotCodeZPL (output *out, const imaging *im, int compress, char *cmd)
+{
+    int row, w, h, nbytes = DotCodeImage(out,im,&w,&h);
+    UCHAR *line, *prev;
+    emitter e;
+    dotscan *s;
+    char head[64];
+
+    if (nbytes < 0) return (-1);
+    line = (UCHAR*)malloc(sizeof(UCHAR) * (nbytes<<1));
+    if ((!line)||(!(s = DotCodeScanStart(out,im,0)))) {
+        free(line);
+        return (-1);
+    }
+    prev = line + nbytes;
+
+    e.cmd = (UCHAR*)cmd;
+    e.n = 0;
+    sprintf(head,"^GFA,%ld,%ld,%d,",(long)nbytes*h,(long)nbytes*h,nbytes);
+    EmitText(&e,head);
+    for (row=0; row<h; row++) {
+        DotCodeScanLines(s,line,1);
+        EmitHexRow(&e,line,(row)? prev:NULL,nbytes,compress);
+        memcpy(prev,line,nbytes);
+    }
+    EmitText(&e,"^FS");
+
+    DotCodeScanStop(s);
+    free(line);
+    return (e.n);
+}
+
+int DotCodeEscPos (output *out, const imaging *im, UCHAR *cmd)
+{
+    int w, h, nbytes = DotCodeImage(out,im,&w,&h);
+    emitter e;
+    dotscan *s;
+
+    if ((nbytes < 0)||(nbytes > 0xffff)||(h > 0xffff)) return (-1);
+
+    e.cmd = cmd;
+    e.n = 0;
+    Emit(&e,0x1d);      // GS v 0, normal density
+    Emit(&e,'v');
+    Emit(&e,'0');
+    Emit(&e,0);
+    Emit(&e,nbytes & 0xff);
+    Emit(&e,nbytes >> 8);
+    Emit(&e,h & 0xff);
+    Emit(&e,h >> 8);
+    if (cmd) {
+        if (!(s = DotCodeScanStart(out,im,0))) return (-1);
+        DotCodeScanLines(s,cmd+e.n,h);
+        DotCodeScanStop(s);
+    }
+    e.n += nbytes * h;
+    return (e.n);
+}
+
+/* ======================================================================= */
+/* *******************      SHEET IMPOSITION      ********************** */
+/* ======================================================================= */
+#define SHEET_BAND 64       /* pixel rows of a sheet imaged at once */
+
+/*-------------------------------------------------------------------------*/
+/*  "Cell(outs,n,im,sh,&cw,&ch)" sets the sheet's cell size, returning -1  */
+/*  if the sheet or any of its images is illegal (or overflows its cell)   */
+/*-------------------------------------------------------------------------*/
+static int Cell (output *outs, int n, const imaging *im, const sheet *sh, int *cw, int *ch)
+{
+    int i, w, h;
+    if ((sh->across < 1)||(sh->down < 1)||(n > sh->across * sh->down)||
+        (sh->gapx < 0)||(sh->gapy < 0)||(sh->margin < 0)) return (-1);
+    *cw = sh->cellw;
+    *ch = sh->cellh;
+    for (i=0; i<n; i++) {
+        if (!outs[i].bitmap) continue;      // (a blank cell)
+        if (DotCodeImage(outs+i,im,&w,&h) < 0) return (-1);
+        if ((sh->cellw > 0)&&(w > sh->cellw)) return (-1);
+        if ((sh->cellh > 0)&&(h > sh->cellh)) return (-1);
+        if (w > *cw) *cw = w;
+        if (h > *ch) *ch = h;
+    }
+    return (0);
+}
+
+int DotCodeSheet (output *outs, int n, const imaging *im, const sheet *sh, int *width, int *height)
+{
+    int cw, ch, w;
+    if (Cell(outs,n,im,sh,&cw,&ch)) return (-1);
+    w = (sh->margin<<1) + sh->across * cw + (sh->across-1) * sh->gapx;
+    if (width) *width = w;
+    if (height) *height = (sh->margin<<1) + sh->down * ch + (sh->down-1) * sh->gapy;
+    return ((w+7)>>3);
+}
+
+int DotCodeSheetRows (output *outs, int n, const imaging *im, const sheet *sh, int row, int nrows, UCHAR *rows)
+{
+    int cw, ch, h, r, c, i, y, gy, nbytes = DotCodeSheet(outs,n,im,sh,NULL,&h);
+    dotview v;
+
+    if ((nbytes < 0)||(row < 0)||(nrows < 0)||(row + nrows > h)) return (-1);
+    Cell(outs,n,im,sh,&cw,&ch);
+    memset(rows,0,nbytes * nrows);
+    for (r=0; r<nrows; r++) {
+        y = row + r - sh->margin;
+        gy = y / (ch + sh->gapy);
+        y -= gy * (ch + sh->gapy);      // the pixel row within its cell
+        if ((y < 0)||(y >= ch)||(gy >= sh->down)) continue;
+        for (c=0; c<sh->across; c++) {
+            if (((i = gy * sh->across + c) >= n)||(!outs[i].bitmap)) continue;
+            ViewDots(&v,outs+i);
+            RenderAt(&v,im,y,rows + r * nbytes,sh->margin + c * (cw + sh->gapx));
+        }
+    }
+    return (nbytes);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "PutLE(f,v,n)" writes "v" as "n" little-endian bytes (BMP headers)     */
+/*-------------------------------------------------------------------------*/
+static void PutLE (FILE *f, long v, int n)
+{
+    while (n--) {
+        fputc((int)(v & 0xff),f);
+        v >>= 8;
+    }
+}
+
+int DotCodeSheetFile (output *outs, int n, const imaging *im, const sheet *sh, int format, const char *fname)
+{
+    int w, h, k, r, first, band, pad, nbytes = DotCodeSheet(outs,n,im,sh,&w,&h);
+    UCHAR *rows;
+    FILE *f;
+
+    if ((nbytes < 0)||((format != DOT_SHEET_BMP)&&(format != DOT_SHEET_PBM))) return (-1);
+    rows = (UCHAR*)malloc(sizeof(UCHAR) * nbytes * SHEET_BAND);
+    if (!rows) return (-1);
+    if (!(f = fopen(fname,"wb"))) {
+        free(rows);
+        return (-1);
+    }
+    pad = (format == DOT_SHEET_BMP)? (-nbytes) & 3 : 0;
+    if (format == DOT_SHEET_PBM) fprintf(f,"P4\n%d %d\n",w,h);
+    else {
+        // a 1 bit BMP, its palette making the 1s black
+        fputs("BM",f);
+        PutLE(f,0x3e + (long)(nbytes+pad) * h,4);
+        PutLE(f,0,4);
+        PutLE(f,0x3e,4);
+        PutLE(f,0x28,4);
+        PutLE(f,w,4);
+        PutLE(f,h,4);
+        PutLE(f,1,2);
+        PutLE(f,1,2);
+        PutLE(f,0,4);
+        PutLE(f,(long)(nbytes+pad) * h,4);
+        PutLE(f,2835,4);    // 72 dpi
+        PutLE(f,2835,4);
+        PutLE(f,2,4);
+        PutLE(f,0,4);
+        PutLE(f,0xffffff,4);
+        PutLE(f,0,4);
+    }
+    for (k=0; k<h; k+=band) {
+        band = (h-k < SHEET_BAND)? h-k : SHEET_BAND;
+        if (format == DOT_SHEET_PBM) {
+            DotCodeSheetRows(outs,n,im,sh,k,band,rows);
+            fwrite(rows,sizeof(UCHAR),nbytes * band,f);
+        }
+        else {      // Bottom row first!!
+            first = h-k-band;
+            DotCodeSheetRows(outs,n,im,sh,first,band,rows);
+            for (r=band-1; r>=0; r--) {
+                fwrite(rows + r * nbytes,sizeof(UCHAR),nbytes,f);
+                PutLE(f,0,pad);
+            }
+        }
+    }
+    k = ferror(f);
+    if (fclose(f)) k = 1;
+    free(rows);
+    return ((k)? -1 : 0);
+}
@@ -0,0 +1,212 @@
+/* ======================================================================= */
+/**   "DotPriv.h" -- DotCode library internals shared between modules    **/
+/* ======================================================================= */
+
+#ifndef DOTPRIV_H
+#define DOTPRIV_H
+
+#include "DotEncod.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define MAXWD 5000   /* Max # of Codewords in a symbol */
+
+/*-------------------------------------------------------------------------*/
+/*******************   SCRATCH MEMORY   ************************************/
+/*-------------------------------------------------------------------------*/
+void *DotAlloc (int n);
+void DotFree (void *p);
+// Notes:
+//		DotAlloc() takes "n" chars from this thread's DotCodeAllocator(), or
+//					malloc(), & DotFree() (on any thread) gives them back
+
+/*-------------------------------------------------------------------------*/
+/*******************   DOT PLACEMENT ("FILL ORDER") MAP   ******************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int rows, cols;			// the symbol size this map was built for,
+	int line, layout;		// ... & its bitmap layout
+	int size;				// the bitmap size in chars
+	int ndots;				// # of dot positions, in fill order
+	int *byte;				// bitmap byte offset of each dot...
+	unsigned char *bit;		// ... & its bit within that byte
+	unsigned short *x, *y;	// ... & its position
+	int scan;				// the DOT_SCAN_X/Y axis "order" sorts for (+1)...
+	int *order, *first;		// ... the dots in column (or row) order, &
+							// where each column (or row) begins there
+} dotmap;
+// NOTE: zero a "dotmap" before first use, & FreeDotMap() when done
+
+int BuildDotMap (dotmap *map, output *out);
+void FreeDotMap (dotmap *map);
+dotmap *ThreadMap (output *out);
+// Notes:
+//		BuildDotMap() lists the dot positions of the sized symbol "out" in
+//					fill order (the 6 corner dots last), keeping "map" if it
+//					already fits, & returns 0, or -1 if out of memory (or
+//					the "out" stride is too short)
+//		ThreadMap() returns the calling thread's map, built for "out" (or
+//					NULL, as above), which it keeps for the next call
+//					until DotCodeThreadDone() (run as each thread the
+//					library starts ends)
+
+/*-------------------------------------------------------------------------*/
+/*******************   BITMAP LAYOUT   *************************************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	unsigned char *bits;	// the bitmap,
+	int rows, cols;			// its size,
+	int line;				// chars from one row (or column) to the next,
+	int layout;				// ... & DOT_xxx layout flags
+} dotview;
+
+void ViewDots (dotview *v, output *out);
+int DotAt (const dotview *v, int x, int y, unsigned char *bit);
+int BitmapSize (output *out);
+void SetLayout (output *out, const options *opt);
+int MessageMode (const options *opt);
+int Printed (const dotview *v, int x, int y);
+long ScoreArray (const dotview *v);
+// Notes:
+//		DotAt() returns the offset of dot "x","y" & sets its "bit" mask
+//					(which, if "DOT_PACKED", must be a dot position)
+//		Printed() returns 1 if "x","y" is a printed dot, else 0 (even off
+//					the symbol)
+//		BitmapSize() returns the chars a sized "out" needs, or -1 if its
+//					stride is too short
+//		SetLayout() gives "out" the "opt" layout (the default if NULL)
+//		MessageMode() is the Tokenize() "literal" that "opt" asks for
+
+/*-------------------------------------------------------------------------*/
+/*******************   CODEWORD PATTERNS & MASKS   *************************/
+/*-------------------------------------------------------------------------*/
+extern const int mask[4];				// the mask ramp steps
+const int *CharPatterns (void);			// the 9-bit patterns of values 0-112
+
+/*-------------------------------------------------------------------------*/
+/*******************   MESSAGE TOKEN STREAM   ******************************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	const unsigned char *b;	// one byte per token (an FNCx as 1 to 3)...
+	const unsigned char *fnc;	// ... & a bitset flagging the FNCs (or NULL)
+	int n;					// # of tokens
+	unsigned char *own;		// storage allocated for "b" & "fnc", if any
+	int pairs;				// 1 if only FNC1s & even runs of digits
+} tokens;
+
+#define GS1_TOKENS 2	/* Tokenize()'s "literal" for GS1 element strings */
+
+int Tokenize (tokens *tk, unsigned char *msg, int msglen, int literal);
+int RawTokens (tokens *tk, unsigned char *msg, int msglen, const fncmark *fncs, int nfnc);
+void FreeTokens (tokens *tk);
+// Notes:
+//		Tokenize() translates the "#x" sequences (unless "literal") while
+//					checking them, using "msg" itself when it has none, or
+//					the GS1 element strings when "literal" is "GS1_TOKENS"
+//		RawTokens() inserts "fncs" among the literal bytes of "msg"
+//		both return 0, or -1 if the message or list is invalid (or out of
+//					memory), & the tokens must be FreeTokens()'d when done
+
+/*-------------------------------------------------------------------------*/
+/*******************   ENCODING STAGES OF DotCodeEncode()   ****************/
+/*-------------------------------------------------------------------------*/
+int EncodeTokens (const tokens *tk, unsigned char *CW);
+int FindDataWords (unsigned char *msg, int msglen, unsigned char *CW, int literal);
+int SymbolSize (int nd, int hgt, int wid, output *out);
+int SymbolWords (output *out, int *nd, int *nc);
+void PadWords (unsigned char *CW, int nd, int ND);
+int EncodeSymbol (dotmap *map, output *out, unsigned char *CW, int nd, int topmsk, int show, int fast);
+int EncodeSymbols (dotmap *map, output **outs, unsigned char **CWs, int nd, int k, int topmsk, int fast);
+int FillSymbol (dotmap *map, output *out, const unsigned char *CW, const unsigned char *chk, int topmsk, int show, int fast);
+// Notes:
+//		EncodeTokens() stores the data codewords, followed by the final
+//					encoding mode, so "CW" needs room for "(n<<4)+4"
+//		FindDataWords() does the same for a message, returning -1 if it
+//					doesn't tokenize
+//		SymbolSize() sets "out" rows & cols for "nd" data codewords, per
+//					the "hgt" & "wid" rules of "inputs", returning the bitmap
+//					size in chars, or -1 if no legal symbol results
+//		SymbolWords() returns the # of codewords in a sized "out" (less the
+//					mask word), setting the # of data & check words
+//		PadWords() pads "nd" data words out to "ND"
+//		EncodeSymbol() pads, masks, R-S encodes & fills a sized "out",
+//					returning 0, or -1 if out of memory
+//		EncodeSymbols() does so for "k" symbols of one size, each with "nd"
+//					data words, R-S encoding them together in lanes
+//		FillSymbol() masks & fills a sized "out" from its padded data words
+//					& the check words of those unmasked (mask word 0)
+
+/*-------------------------------------------------------------------------*/
+/*******************   MASK SELECTION COUNTERS   ***************************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	int mask;				// the mask filled (0-7)
+	int fast;				// non-0 if selected in "fast" mode...
+	int bypass;				// ... & it stopped early
+	int scored;				// # of candidates scored (0 if dictated)
+	int unlit;				// ... & how many had an unlit edge
+	long margin;			// the best score less the threshold
+	int sampled;			// non-0 if the candidates were scored by sample,
+	long error;				// ... & how far the chosen one's estimate was off
+} maskpick;
+
+void CountFill (const maskpick *sel);
+// Notes:
+//		CountFill() adds one symbol's mask selection to the DotCodeStats()
+//					counters
+
+/*-------------------------------------------------------------------------*/
+/*******************   R-S ENCODING   **************************************/
+/*-------------------------------------------------------------------------*/
+#define RSLANES 16				/* symbols R-S encoded at once */
+
+const unsigned char *GenPoly (int nc);
+void RsEncodeLanes (unsigned short *w, int nd, int nc);
+int CrossCount (const dotview *v);
+int CrossCountRows (const dotview *v, int y0, int y1);
+// Notes:
+//		GenPoly() returns the generator polynomial of order "nc" (highest
+//					power first), valid until called for two other orders
+//		RsEncodeLanes() adds "nc" check words to the "nd" data words of
+//					RSLANES symbols at once, just as rsencode() does to wd[],
+//					word "i" of symbol "s" being "w[i*RSLANES + s]"
+//		CrossCount() counts the dots ScoreArray() penalizes, unprinted
+//					with no printed diagonal neighbours, or printed & with
+//					no printed neighbours at all, or returns -1 if the symbol
+//					is too wide for it
+//		CrossCountRows() counts them in rows "y0" thru "y1"-1 alone
+//		both run the best kernels DotCodeCpu() finds
+
+/*-------------------------------------------------------------------------*/
+/*******************   REFERENCE ENCODER & TRACING   ***********************/
+/*-------------------------------------------------------------------------*/
+typedef struct {
+	long long ns[DOT_STAGES];	// nanoseconds spent in each stage
+	int mask;				// the mask filled (0-7)
+	int nw;					// # of codewords (the mask word included)...
+	int words[MAXWD];		// ... & the codewords filled
+} encodetrace;
+
+int RefMode (void);
+int RefSymbol (output *out, const unsigned char *CW, int nd, int topmsk, int show, int fast);
+void TraceEncoding (encodetrace *t);
+encodetrace *Tracing (void);
+void ListEncoding (dotlist *list);
+dotlist *Listing (void);
+// Notes:
+//		RefMode() is non-0 if this thread should encode by the reference
+//		RefSymbol() is EncodeSymbol() as the reference (rev 2.24) encoder
+//					did it, which EncodeSymbol() calls in reference mode
+//		TraceEncoding() has this thread's symbol fills add their stage
+//					times & record their mask & codewords in "t" (until
+//					NULL), which Tracing() returns
+//		ListEncoding() has this thread's symbol fills list their printed
+//					dots in "list" (until NULL), which Listing() returns
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,324 @@
+/* ======================================================================= */
+/**   "DotRange.c" -- DotCode serial number range generator  (batch mode) **/
+/* ======================================================================= */
+
+// DotCodeRange() encodes one symbol per serial number, each being the
+//  template message with the serial's digits inserted.  Each worker counts
+//  the serial up in place in its copy of the message, but still encodes the
+//  whole message into codewords afresh for every serial (the data encoder
+//  looks ahead, so a digit may change the codewords before it).  What's
+//  reused is the rest: consecutive serials rarely change the symbol size,
+//  so each worker keeps its size decision & dot placement map (& the R-S
+//  generators, per thread) from one serial to the next, re-sizing only
+//  when the # of data words changes.
+//
+// Worker threads claim "CHUNK" consecutive serials at a time, encoding each
+//  into its own slot of a ring; the calling thread hands the slots to the
+//  caller's sink in serial order, so the output never depends on timing.
+//  The symbols of a chunk that share a size are R-S encoded together, in
+//  SIMD lanes (see "DotSimd.c").
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define UCHAR unsigned char
+
+#define CHUNK 16            /* consecutive serials claimed by a worker */
+
+#define SLOT_FREE  0
+#define SLOT_BUSY  1
+#define SLOT_READY 2
+
+typedef struct {
+    long serial;
+    int state;              // SLOT_xxx
+    int nbytes;             // bitmap size, or -1 if this serial failed
+    int room;               // bitmap allocation
+    output out;
+} slot;
+
+typedef struct {
+    inputs *in;             // the template,
+    int at, digits;         // ... where & how the serial is inserted
+    long first, last;
+    options *opt;
+
+    dcmutex lock;           // guards all below
+    dccond cond;
+    long next;              // the next serial to be claimed
+    long due;               // ... & the next to be handed to the sink
+    int stop;
+    int nslots;
+    slot *slots;
+} rangejob;
+
+typedef struct {
+    rangejob *job;
+    dcthread thread;
+    dotmap map;             // the placement map of the last size encoded
+    UCHAR *msg;             // the current message...
+    UCHAR *CW[CHUNK];       // ... & the codewords of each serial in the chunk
+    int len, ndig;          // message length & # of serial digits in it
+    long serial;            // the serial currently in "msg"
+    int nd, rows, cols;     // the last size decision
+} rangeworker;
+
+/*-------------------------------------------------------------------------*/
+/*  "PutSerial(wk,serial)" writes "serial" into the worker's message,      */
+/*  counting up in place when it follows the last one without a carry out  */
+/*-------------------------------------------------------------------------*/
+static void PutSerial (rangeworker *wk, long serial)
+{
+    rangejob *job = wk->job;
+    char digits[24];
+    int n;
+
+    if ((wk->len)&&(serial == wk->serial+1)) {
+        UCHAR *first = wk->msg + job->at, *d = first + wk->ndig;
+        while (d-- > first) {
+            if (*d < '9') {
+                (*d)++;
+                wk->serial = serial;
+                return;
+            }
+            *d = '0';
+        }
+    }
+    n = sprintf(digits,"%0*ld",job->digits,serial);
+    memcpy(wk->msg,job->in->msg,job->at);
+    memcpy(wk->msg+job->at,digits,n);
+    memcpy(wk->msg+job->at+n,job->in->msg+job->at,job->in->msglen-job->at);
+    wk->len = job->in->msglen + n;
+    wk->ndig = n;
+    wk->serial = serial;
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "SizeSerial(wk,serial,sl,CW)" finds one serial's codewords (in "CW",   */
+/*  from the whole message) & symbol size (in "sl", kept from the last     */
+/*  serial unless the # of data words differs), returning that #, or -1    */
+/*-------------------------------------------------------------------------*/
+static int SizeSerial (rangeworker *wk, long serial, slot *sl, UCHAR *CW)
+{
+    rangejob *job = wk->job;
+    output *out = &sl->out;
+    int nd, n;
+
+    PutSerial(wk,serial);
+    SetLayout(out,job->opt);
+    nd = FindDataWords(wk->msg,wk->len,CW,MessageMode(job->opt));
+
+    // the size rarely changes within a range, so only re-size when "nd" does
+    if (nd != wk->nd) {
+        wk->nd = nd;
+        if ((nd < 0)||(SymbolSize(DotCodeEccWords(nd,job->opt->ecc),job->in->hgt,job->in->wid,out) < 0)) wk->rows = wk->cols = 0;
+        else {
+            wk->rows = NROW;
+            wk->cols = NCOL;
+        }
+    }
+    sl->nbytes = -1;
+    if (!wk->rows) return (-1);
+    NROW = wk->rows;
+    NCOL = wk->cols;
+    if ((n = BitmapSize(out)) < 0) return (-1);
+
+    if (sl->room < n) {
+        free(BMAP);
+        sl->room = n;
+        if (!(BMAP = (UCHAR*)malloc(sizeof(UCHAR) * sl->room))) {
+            sl->room = 0;
+            return (-1);
+        }
+    }
+    sl->nbytes = n;
+    return (nd);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "EncodeChunk(wk,first,sls,n)" encodes serials "first" on into the "n"  */
+/*  slots "sls", each run of one size R-S encoded together                 */
+/*-------------------------------------------------------------------------*/
+static void EncodeChunk (rangeworker *wk, long first, slot **sls, int n)
+{
+    rangejob *job = wk->job;
+    output *outs[CHUNK];
+    int i, j, k, nd[CHUNK];
+
+    for (i=0; i<n; i++) nd[i] = SizeSerial(wk,first+i,sls[i],wk->CW[i]);
+    for (i=0; i<n; i=j) {
+        for (j=i; (j<n)&&(nd[j] == nd[i]); j++) outs[j-i] = &sls[j]->out;
+        if ((nd[i] >= 0)&&(EncodeSymbols(&wk->map,outs,wk->CW+i,nd[i],j-i,job->opt->topmsk,job->opt->fast)))
+            for (k=i; k<j; k++) sls[k]->nbytes = -1;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "RangeWorker(wk)" claims chunks of serials until the range is done     */
+/*-------------------------------------------------------------------------*/
+static void RangeWorker (void *arg)
+{
+    rangeworker *wk = (rangeworker*)arg;
+    rangejob *job = wk->job;
+    slot *sls[CHUNK];
+    long s, end;
+    int i, n;
+
+    MutexLock(&job->lock);
+    while ((!job->stop)&&(job->next <= job->last)) {
+        s = job->next;
+        end = ((job->last - s) < CHUNK)? job->last : s+CHUNK-1;
+        job->next = end+1;
+        n = (int)(end-s+1);
+        // (a slot is only reused once the sink has had its last serial)
+        while ((end - job->due >= job->nslots)&&(!job->stop)) CondWait(&job->cond,&job->lock);
+        if (job->stop) break;
+        for (i=0; i<n; i++) {
+            sls[i] = job->slots + (s+i - job->first) % job->nslots;
+            sls[i]->state = SLOT_BUSY;
+            sls[i]->serial = s+i;
+        }
+        MutexUnlock(&job->lock);
+
+        EncodeChunk(wk,s,sls,n);
+
+        MutexLock(&job->lock);
+        for (i=0; i<n; i++) sls[i]->state = SLOT_READY;
+        CondWake(&job->cond);
+    }
+    MutexUnlock(&job->lock);
+}
+
+static int InitWorker (rangeworker *wk, rangejob *job)
+{
+    int i, ok;
+    memset(wk,0,sizeof(rangeworker));
+    wk->job = job;
+    wk->nd = -1;
+    wk->msg = (UCHAR*)malloc(sizeof(UCHAR) * (job->in->msglen + 24));
+    ok = (wk->msg != NULL);
+    for (i=0; i<CHUNK; i++) {
+        wk->CW[i] = (UCHAR*)malloc(sizeof(UCHAR) * ((job->in->msglen + 24)<<4) + 4);
+        if (!wk->CW[i]) ok = 0;
+    }
+    return ((ok)? 0:-1);
+}
+
+static void FreeWorker (rangeworker *wk)
+{
+    int i;
+    FreeDotMap(&wk->map);
+    free(wk->msg);
+    for (i=0; i<CHUNK; i++) free(wk->CW[i]);
+}
+
+/* ======================================================================= */
+/* *******************      RANGE GENERATOR API      ********************* */
+/* ======================================================================= */
+
+int DotCodeRange (inputs *in, int at, int digits, long first, long last,
+                  options *opt, int threads, serialsink sink, void *user)
+{
+    rangejob job;
+    rangeworker *wks;
+    long s;
+    int i, n = 0, ok = 1;
+
+    if ((at < 0)||(at > in->msglen)||(first < 0)||(last < first)||(digits < 0)||(digits > 20)) return (-1);
+
+    // the template's #-sequences must terminate legally, & not straddle "at"
+    if (!MessageMode(opt)) {
+        for (i=0; i<in->msglen; i++) {
+            if (in->msg[i] == '#') {
+                i++;
+                if ((i == at)||(i >= in->msglen)) return (-1);
+                if ((in->msg[i] != '#')&&((in->msg[i] < '0')||(in->msg[i] > '3'))) return (-1);
+            }
+        }
+    }
+
+    memset(&job,0,sizeof(rangejob));
+    job.in = in;
+    job.at = at;
+    job.digits = digits;
+    job.first = job.next = job.due = first;
+    job.last = last;
+    job.opt = opt;
+    if ((long)threads > last-first+1) threads = (int)(last-first+1);
+    if (threads < 1) threads = 1;
+
+    job.nslots = (threads > 1)? 2 * threads * CHUNK : CHUNK;
+    job.slots = (slot*)calloc(job.nslots,sizeof(slot));
+    wks = (rangeworker*)calloc(threads,sizeof(rangeworker));
+    if ((!job.slots)||(!wks)) ok = 0;
+    for (i=0; (ok)&&(i<threads); i++) if (InitWorker(wks+i,&job)) ok = 0;
+
+    if (!ok) n = -1;
+    else if (threads == 1) {    // encode inline on the calling thread
+        slot *sls[CHUNK];
+        int k, stop = 0;
+        for (i=0; i<CHUNK; i++) sls[i] = job.slots + i;
+        for (s=first; (!stop)&&(s<=last); s+=k) {
+            k = ((last - s) < CHUNK)? (int)(last-s+1) : CHUNK;
+            EncodeChunk(wks,s,sls,k);
+            for (i=0; (!stop)&&(i<k); i++) {
+                if (sls[i]->nbytes < 0) {
+                    n = -1;
+                    stop = 1;
+                }
+                else {
+                    n++;
+                    stop = sink(user,s+i,&sls[i]->out,sls[i]->nbytes);
+                }
+            }
+        }
+    }
+    else {
+        int started;
+        MutexInit(&job.lock);
+        CondInit(&job.cond);
+        for (started=0; started<threads; started++)
+            if (ThreadStart(&wks[started].thread,RangeWorker,wks+started)) break;
+        if (!started) n = -1;
+
+        // hand each slot to the sink in serial number order
+        for (s=first; (started)&&(s<=last); s++) {
+            slot *sl = job.slots + (s - first) % job.nslots;
+            int stop = 0;
+            MutexLock(&job.lock);
+            while ((sl->state != SLOT_READY)||(sl->serial != s)) CondWait(&job.cond,&job.lock);
+            MutexUnlock(&job.lock);
+
+            if (sl->nbytes < 0) {
+                n = -1;
+                stop = 1;
+            }
+            else {
+                n++;
+                stop = sink(user,s,&sl->out,sl->nbytes);
+            }
+
+            MutexLock(&job.lock);
+            sl->state = SLOT_FREE;
+            job.due = s+1;
+            if (stop) job.stop = 1;
+            CondWake(&job.cond);
+            MutexUnlock(&job.lock);
+            if (stop) break;
+        }
+        for (i=0; i<started; i++) ThreadJoin(wks[i].thread);
+        CondFree(&job.cond);
+        MutexFree(&job.lock);
+    }
+
+    for (i=0; (wks)&&(i<threads); i++) FreeWorker(wks+i);
+    for (i=0; (job.slots)&&(i<job.nslots); i++) free(job.slots[i].out.bitmap);
+    free(wks);
+    free(job.slots);
+    return (n);
+}
@@ -0,0 +1,494 @@
+/* ======================================================================= */
+/**  "DotRef.c" -- the reference (rev 2.24) symbol encoder & a checker    **/
+/* ======================================================================= */
+
+// Here the symbol is masked, R-S encoded, filled & scored just as the AIM
+//  reference encoder (rev 2.24) did it, plainly & one mask at a time: each
+//  mask's check words are computed afresh, the dots placed by walking the
+//  symbol, & the score read from an ordinary bitmap (of rows of bits), which
+//  is then copied into the caller's layout.  DotCodeReference() switches all
+//  encoding over to it, & DotCodeCompare() runs a message through both this
+//  & the optimized encoder, comparing codewords, mask & bitmap & timing the
+//  stages of each.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define UCHAR unsigned char
+#define GF 113      /* Size of the Galois field */
+#define PM 3        /* Prime Modulus for the Galois field */
+
+#define SCORE_UNLIT_EDGE    -99999
+
+static volatile long refmode;       // DotCodeReference(), for every thread
+static THREAD_LOCAL int refhere;    // ... unless comparing on this one (1 ref, -1 not)
+
+int RefMode (void)
+{
+    if (refhere) return (refhere > 0);
+    return ((int)AtomicLoad(&refmode));
+}
+
+int DotCodeReference (int on)
+{
+    long was;
+    do was = AtomicLoad(&refmode);
+    while (!AtomicSwap(&refmode,was,(on)? 1:0));
+    return ((int)was);
+}
+
+/* ======================================================================= */
+/* **********************      REFERENCE KERNELS      ******************** */
+/* ======================================================================= */
+/*-------------------------------------------------------------------------*/
+/*  "RefRsEncode(w,nd,nc)" adds "nc" R-S check words to "nd" data words in */
+/*  "w", generating the generator polynomials as it goes                   */
+/*-------------------------------------------------------------------------*/
+static void RefRsEncode (int *w, int nd, int nc)
+{
+    int i, j, k, nw, start, step;
+    int root[GF], c[GF];
+
+    nw = nd+nc;
+    step = (nw+GF-2)/(GF-1);
+    for (start=0; start<step; start++) {
+        int ND = (nd-start+step-1)/step, NW = (nw-start+step-1)/step, NC = NW-ND;
+
+        /* First time through, begin by generating "NC+1" roots (antilogs):   */
+        if (!start) {   // LARGE FIX
+            root[0] = 1;
+            for (i=1; i<=(NC+1); i++) root[i] = (PM * root[i-1]) % GF;
+        }
+
+        /* Compute also the generator polynomial "c" of order "NC": */
+        for (i=1; i<=NC; i++) c[i] = 0;
+        c[0] = 1;
+        for (i=1; i<=NC; i++) {
+            for (j=NC; j>=1; j--) {
+                c[j] = (GF + c[j] - (root[i] * c[j-1]) % GF) % GF;
+            }
+        }
+
+        // Finally compute the corresponding checkword values into w[], starting at w[start] & stepping by step
+        for (i=ND; i<NW; i++) w[start+i*step] = 0;
+        for (i=0; i<ND; i++) {
+            k = (w[start+i*step] + w[start+ND*step]) % GF;
+            for (j=0; j<NC-1; j++) {
+                w[start+(ND+j)*step] = (GF - ((c[j+1] * k) % GF) + w[start+(ND+j+1)*step]) % GF;
+            }
+            w[start+(ND+NC-1)*step] = (GF - ((c[NC] * k) % GF)) % GF;
+        }
+        for (i=ND; i<NW; i++) w[start+i*step] = (GF - w[start+i*step]) % GF;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/*  The reference bitmap: "rows" rows of "(cols+7)/8" bytes, MSB first     */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    UCHAR *bits;
+    int rows, cols, line;
+    const int *w;       // the codewords being filled...
+    int nw, pat, msk;   // ... the # left, & the current pattern & bit
+} refmap;
+
+static void RefSet (refmap *m, int x, int y)
+{
+    m->bits[y * m->line + (x >> 3)] |= 0x80 >> (x&7);
+}
+
+static void NextDot (refmap *m, int x, int y)
+{
+    if (m->pat & m->msk) RefSet(m,x,y);
+    m->msk >>= 1;
+    if (!m->msk) {
+        m->msk = 0x100;
+        m->nw--;
+        m->pat = (m->nw > 0)? CharPatterns()[*(++m->w)] : 0x1ff;   // (then lighting any leftovers)
+    }
+}
+
+static void RefCorners (refmap *m)
+{
+    int rows = m->rows, cols = m->cols;
+    if (rows & 1) { // Odd symbol height
+        RefSet(m,cols-2,0);
+        RefSet(m,cols-2,rows-1);
+        RefSet(m,cols-1,1);
+        RefSet(m,cols-1,rows-2);
+        RefSet(m,0,0);
+        RefSet(m,0,rows-1);
+    }
+    else {      // Even symbol height
+        RefSet(m,cols-1,rows-2);
+        RefSet(m,0,rows-2);
+        RefSet(m,cols-2,rows-1);
+        RefSet(m,1,rows-1);
+        RefSet(m,cols-1,0);
+        RefSet(m,0,0);
+    }
+}
+
+static void RefFill (refmap *m, const int *w, int nw)
+{
+    int x, y, rows = m->rows, cols = m->cols;
+    m->w = w;
+    m->nw = nw;
+    m->pat = *w;
+    m->msk = 0x02;
+    memset(m->bits,0,sizeof(UCHAR) * rows * m->line);
+    if (rows & 1) { // Odd symbol height
+        x = 0;
+        y = rows-1;
+        do {
+            if ((((y>0)&&(y<rows-1))||((x>0)&&(x<cols-2)))&&(((y>1)&&(y<rows-2))||(x<cols-1))) {
+                NextDot(m,x,y);
+            }
+            x += 2;
+            if (x >= cols) x = (--y) & 1;
+        }
+        while (y >= 0);
+        NextDot(m,cols-2,0);
+        NextDot(m,cols-2,rows-1);
+        NextDot(m,cols-1,1);
+        NextDot(m,cols-1,rows-2);
+        NextDot(m,0,0);
+        NextDot(m,0,rows-1);
+    }
+    else {      // Even symbol height
+        x = y = 0;
+        do {
+            if ((((x>0)&&(x<cols-1))||((y>0)&&(y<rows-2)))&&(((x>1)&&(x<cols-2))||(y<rows-1))) {
+                NextDot(m,x,y);
+            }
+            y += 2;
+            if (y >= rows) y = (++x) & 1;
+        }
+        while (x < cols);
+        NextDot(m,cols-1,rows-2);
+        NextDot(m,0,rows-2);
+        NextDot(m,cols-2,rows-1);
+        NextDot(m,1,rows-1);
+        NextDot(m,cols-1,0);
+        NextDot(m,0,0);
+    }
+}
+
+static int RefPrinted (const refmap *m, int x, int y)
+{
+    if ((x >= 0)&&(x < m->cols)&&(y >= 0)&&(y < m->rows)) {
+        if (m->bits[y * m->line + (x>>3)] & (0x80 >> (x&7))) return (1);
+    }
+    return (0);
+}
+
+static int RefPenalty (const refmap *m, int cols)
+{
+    int i, k, n = (cols)? m->cols : m->rows, N = (cols)? m->rows : m->cols, clr;
+    int penalty = 0, penalty_local = 0;
+    for (i=1; i<n-1; i++) {
+        for (k=i&1,clr=1; (clr)&&(k<N); k+=2) if ((cols)? RefPrinted(m,i,k) : RefPrinted(m,k,i)) clr = 0;
+        if (clr) {
+            if (penalty_local == 0) penalty_local = N;
+            else penalty_local *= N;
+        }
+        else {
+            if (penalty_local) {
+                penalty += penalty_local;
+                penalty_local = 0;
+            }
+        }
+    }
+    return penalty + penalty_local;
+}
+
+static long RefScore (const refmap *m)
+{
+    int Hgt = m->rows, Wid = m->cols;
+    int x, y, worstedge, first, last, sum;
+    long penalty;
+
+    penalty = RefPenalty(m,0) + RefPenalty(m,1);
+
+    // across the top edge, count printed dots and measure their extent
+    for (x=sum=0,first=last=-1; x<Wid; x+=2)
+        if (RefPrinted(m,x,0)) {
+            if (first<0) first = x;
+            last = x;
+            sum++;
+        }
+    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty top edge
+    worstedge = sum + last-first;
+    worstedge *= Hgt;
+
+    // across the bottom edge, ditto
+    for (x=Wid&1,sum=0,first=last=-1; x<Wid; x+=2)
+        if (RefPrinted(m,x,Hgt-1)) {
+            if (first<0) first = x;
+            last = x;
+            sum++;
+        }
+    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty bottom edge
+    sum += last-first;
+    sum *= Hgt;
+    if (sum < worstedge) worstedge = sum;
+
+    // down the left edge, ditto
+    for (y=sum=0,first=last=-1; y<Hgt; y+=2)
+        if (RefPrinted(m,0,y)) {
+            if (first<0) first = y;
+            last = y;
+            sum++;
+        }
+    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty left edge
+    sum += last-first;
+    sum *= Wid;
+    if (sum < worstedge) worstedge = sum;
+
+    // down the right edge, ditto
+    for (y=Hgt&1,sum=0,first=last=-1; y<Hgt; y+=2)
+        if (RefPrinted(m,Wid-1,y)) {
+            if (first<0) first = y;
+            last = y;
+            sum++;
+        }
+    if (sum == 0) return SCORE_UNLIT_EDGE;      // guard against empty right edge
+    sum += last-first;
+    sum *= Wid;
+    if (sum < worstedge) worstedge = sum;
+
+    // throughout the array, count the # of unprinted 5-somes (cross patterns)
+    // plus the # of printed dots surrounded by 8 unprinted neighbors
+    for (y=0,sum=0; y<Hgt; y++) {
+        for (x=y&1; x<Wid; x+=2) {
+            if ((!RefPrinted(m,x-1,y-1)) && (!RefPrinted(m,x+1,y-1))
+                    && (!RefPrinted(m,x-1,y+1)) &&(!RefPrinted(m,x+1,y+1))
+                    && ((!RefPrinted(m,x,y)) || ((!RefPrinted(m,x-2,y))
+                            && (!RefPrinted(m,x,y-2)) && (!RefPrinted(m,x+2,y))
+                            && (!RefPrinted(m,x,y+2)))
+                       )
+               ) sum++;
+        }
+    }
+
+    return (worstedge - sum*sum - penalty);
+}
+
+/* ======================================================================= */
+/* *********************      REFERENCE ENCODING      ******************** */
+/* ======================================================================= */
+/*-------------------------------------------------------------------------*/
+/*  "RefList(list,m)" lists the printed dots of the filled bitmap line by  */
+/*  line along the scan, as FillListDots() orders them                     */
+/*-------------------------------------------------------------------------*/
+static void RefList (dotlist *list, const refmap *m)
+{
+    int scan = list->scan & DOT_SCAN_Y, nlines, npos, i, j, k, x, y, n = 0;
+
+    nlines = (scan)? m->rows : m->cols;
+    npos = (scan)? m->cols : m->rows;
+    for (i=0; i<nlines; i++) {
+        j = (list->scan & DOT_SCAN_REVERSE)? nlines-1-i : i;
+        if (list->line) list->line[i] = n;
+        for (k=0; k<npos; k++) {
+            x = (scan)? k : j;
+            y = (scan)? j : k;
+            if (RefPrinted(m,x,y)) {
+                list->x[n] = (unsigned short)x;
+                list->y[n] = (unsigned short)y;
+                n++;
+            }
+        }
+    }
+    if (list->line) list->line[nlines] = n;
+    list->ndots = n;
+}
+
+#define STAGE(s,stmt) { long long t0 = (tr)? ClockNs() : 0; stmt; if (tr) tr->ns[s] += ClockNs() - t0; }
+
+/*-------------------------------------------------------------------------*/
+/*  "MaskAll(w,dw,msk,ND,NC)" masks the padded data words "dw" by "msk"    */
+/*  into "w" & R-S encodes them                                            */
+/*-------------------------------------------------------------------------*/
+static void MaskAll (int *w, const UCHAR *dw, int msk, int ND, int NC)
+{
+    int i;
+    w[0] = msk;
+    for (i=0; i<ND; i++) w[i+1] = (dw[i] + i*mask[msk])%GF;
+    RefRsEncode(w,ND+1,NC);
+}
+
+int RefSymbol (output *out, const UCHAR *CW, int nd, int topmsk, int show, int fast)
+{
+    encodetrace *tr = Tracing();
+    int i, ND, NC, NW, msk, *w, fail = 0;
+    long score, topscore;
+    UCHAR *dw;
+    refmap m;
+    output ref;
+
+    fast &= ~DOT_FAST_SAMPLED;      // (the reference always scores exactly)
+
+    NW = SymbolWords(out,&ND,&NC);
+    if (show) printf("Total # dots = %d\n",(NROW * NCOL)>>1);
+    m.rows = NROW;
+    m.cols = NCOL;
+    m.line = (NCOL+7)>>3;
+    w = (int*)DotAlloc(sizeof(int) * (NW+1));
+    dw = (UCHAR*)DotAlloc(sizeof(UCHAR) * (ND+nd+2));
+    m.bits = (UCHAR*)DotAlloc(sizeof(UCHAR) * m.rows * m.line);
+    if ((!w)||(!dw)||(!m.bits)) {
+        DotFree(w);
+        DotFree(dw);
+        DotFree(m.bits);
+        return (-1);
+    }
+    memcpy(dw,CW,sizeof(UCHAR) * (nd+1));   // (the final mode, too)
+    PadWords(dw,nd,ND);
+
+    if (!((topmsk >= 0)&&(topmsk <= 7))) {
+        int threshold = (NROW*NCOL)>>1;
+        topscore = LONG_MIN;
+        for (msk=3; msk>=0; msk--) {
+            STAGE(DOT_STAGE_RS, MaskAll(w,dw,msk,ND,NC));
+            STAGE(DOT_STAGE_FILL, RefFill(&m,w,NW+1));
+
+            STAGE(DOT_STAGE_SCORE, score = RefScore(&m));
+            if (score > topscore) {
+                topscore = score;
+                topmsk = msk;
+
+                // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
+                if (fast) {
+                    if (topscore > threshold)
+                        break;
+                }
+            }
+            if (fast) {
+                STAGE(DOT_STAGE_FILL, RefCorners(&m));
+                STAGE(DOT_STAGE_SCORE, score = RefScore(&m));
+                if (score > topscore) {
+                    topscore = score;
+                    topmsk = msk + 4;
+
+                    // if topscore now exceeds 1/2 Height x Width, this mask is Acceptable!
+                    if (topscore > threshold)
+                        break;
+                }
+            }
+        } // for loop over masks
+
+        if (!fast && topscore <= threshold) {
+            for (msk=3; msk>=0; msk--) {
+                STAGE(DOT_STAGE_RS, MaskAll(w,dw,msk,ND,NC));
+                STAGE(DOT_STAGE_FILL, RefFill(&m,w,NW+1); RefCorners(&m));
+
+                STAGE(DOT_STAGE_SCORE, score = RefScore(&m));
+                if (score > topscore) {
+                    topscore = score;
+                    topmsk = msk + 4;
+                }
+            }
+        }
+    }
+
+    STAGE(DOT_STAGE_RS, MaskAll(w,dw,topmsk % 4,ND,NC));
+    STAGE(DOT_STAGE_FILL, RefFill(&m,w,NW+1); if (topmsk >= 4) RefCorners(&m));
+    if (show) {
+        printf("\nFull Char Sequence: ");
+        for (i=0; i<ND+1; i++) printf(" %d",w[i]);
+        printf(" |");
+        for (; i<NW+1; i++) printf(" %d",w[i]);
+        printf("\nSelected Mask: %d  =>  Score = %ld\n",topmsk,RefScore(&m));
+    }
+    if (tr) {
+        tr->mask = topmsk;
+        tr->nw = NW+1;
+        memcpy(tr->words,w,sizeof(int) * (NW+1));
+    }
+    if (Listing()) RefList(Listing(),&m);
+
+    // & finally into the caller's layout
+    memset(&ref,0,sizeof(output));
+    ref.bitmap = m.bits;
+    ref.rows = NROW;
+    ref.cols = NCOL;
+    if (DotCodeConvert(&ref,out,1) < 0) fail = 1;
+    DotFree(w);
+    DotFree(dw);
+    DotFree(m.bits);
+    return ((fail)? -1:0);
+}
+
+/* ======================================================================= */
+/* *******************      DIFFERENTIAL CHECKER      ******************** */
+/* ======================================================================= */
+
+int DotCodeCompare (inputs *in, options *opt, diffreport *rep)
+{
+    UCHAR *CW = (UCHAR*)malloc(sizeof(UCHAR) * (LEN<<4) + 4);
+    encodetrace *tr = (encodetrace*)calloc(2,sizeof(encodetrace));
+    output outs[2];
+    dotmap map;
+    long long t0;
+    int i, k, nd, n = -1, same = 1;
+
+    memset(outs,0,sizeof(outs));
+    memset(&map,0,sizeof(dotmap));
+    // [0] is the optimized encoder & [1] the reference, each traced, &
+    // taking turns to go first (& so to warm the caches for the other)
+    for (k=0; (CW)&&(tr)&&(k<2); k++) {
+        i = (int)((k + rep->symbols) & 1);
+        refhere = (i)? 1:-1;
+        TraceEncoding(tr+i);
+        t0 = ClockNs();
+        nd = FindDataWords(MSG,LEN,CW,MessageMode(opt));
+        tr[i].ns[DOT_STAGE_DATA] += ClockNs() - t0;
+        SetLayout(outs+i,opt);
+        if ((nd < 0)||((n = SymbolSize(DotCodeEccWords(nd,opt->ecc),HGT,WID,outs+i)) < 0)) break;
+        if ((!(outs[i].bitmap = (UCHAR*)malloc(sizeof(UCHAR) * n)))||
+            (EncodeSymbol(&map,outs+i,CW,nd,opt->topmsk,0,opt->fast))) {
+            n = -1;
+            break;
+        }
+    }
+    refhere = 0;
+    TraceEncoding(NULL);
+
+    // no difference at all is expected
+    if ((CW)&&(tr)&&(n >= 0)) {
+        rep->symbols++;
+        if ((tr[0].nw != tr[1].nw)||(memcmp(tr[0].words,tr[1].words,sizeof(int) * tr[0].nw))) {
+            rep->words++;
+            same = 0;
+        }
+        if (tr[0].mask != tr[1].mask) {
+            rep->masks++;
+            same = 0;
+        }
+        if (memcmp(outs[0].bitmap,outs[1].bitmap,n)) {
+            rep->bitmaps++;
+            same = 0;
+        }
+        if (!same) rep->differ++;
+        for (i=0; i<DOT_STAGES; i++) {
+            rep->optns[i] += tr[0].ns[i];
+            rep->refns[i] += tr[1].ns[i];
+        }
+        n = (same)? 0:1;
+    }
+    else n = -1;
+
+    free(outs[0].bitmap);
+    free(outs[1].bitmap);
+    FreeDotMap(&map);
+    free(tr);
+    free(CW);
+    return (n);
+}
@@ -0,0 +1,324 @@
+/* ======================================================================= */
+/**  "DotSimd.c" -- vector kernels, chosen at run time by the CPU's ISA   **/
+/* ======================================================================= */
+
+// A run of symbols of one size (as in a serial number range) shares its R-S
+//  block structure & generator polynomials, so their check words can be
+//  computed side by side: each codeword position holds RSLANES 16-bit lanes,
+//  one per symbol, & the encoder's shift register runs once for them all.
+//  GF(113) products stay below 2^16, & are reduced without division as
+//  "x - 113 * ((x * 580) >> 16)", which is exact for every "x" below 13000.
+//  AVX2 takes all 16 lanes in one register, SSE2 in two, & otherwise a
+//  plain loop runs over the lanes.
+//
+// Scoring's neighbour tests are done a row at a time on 64 dots at once:
+//  a row's dots become a bit string (bit "x" being dot "x"), & shifting
+//  the strings of the rows around it lines up every dot's neighbours, so
+//  that a few ANDs & ORs & a population count find the empty crosses &
+//  isolated dots in a whole word.
+//
+// Every variant is built into the one binary (on x86, by GCC & Clang
+//  "target" attributes), & the best the CPU supports is chosen once, by
+//  cpuid, unless the DOTCODE_CPU environment variable caps it.  Older
+//  Visual C++ lacks some intrinsics: before 2008 (_MSC_VER 1500) there's
+//  no __popcnt(), so no SSE4.2 level, & before 2012 (1700) no AVX2 (nor
+//  the __cpuidex() & _xgetbv() that detect it), so no AVX2 level.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#include <immintrin.h>
+#define X86
+#define X86_POPCNT
+#define X86_AVX2
+#define TARGET(isa) __attribute__((target(isa)))
+#define POPCNT(x) __builtin_popcountll(x)
+#elif defined(_MSC_VER)&&(defined(_M_X64)||defined(_M_IX86))
+#include <intrin.h>
+#include <emmintrin.h>
+#define X86
+#if (_MSC_VER >= 1500)
+#define X86_POPCNT
+#define POPCNT(x) ((int)__popcnt((unsigned int)(x)) + (int)__popcnt((unsigned int)((x) >> 32)))
+#endif
+#if (_MSC_VER >= 1700)
+#include <immintrin.h>
+#define X86_AVX2
+#endif
+#define TARGET(isa)
+#endif
+
+#define GF 113      /* Size of the Galois field */
+#define GF_RECIP 580    /* 2^16 / GF, rounded up */
+
+typedef unsigned long long u64;
+
+/* ======================================================================= */
+/* *********************      CPU DISPATCH      ************************* */
+/* ======================================================================= */
+static volatile long cpulevel = -1;
+
+/*-------------------------------------------------------------------------*/
+/*  "CpuSupports()" returns the best DOT_CPU_xxx level this CPU (& its OS) */
+/*  supports                                                               */
+/*-------------------------------------------------------------------------*/
+static int CpuSupports (void)
+{
+#if defined(X86)&&defined(__GNUC__)
+    __builtin_cpu_init();
+    if ((__builtin_cpu_supports("avx2"))&&(__builtin_cpu_supports("popcnt"))) return (DOT_CPU_AVX2);
+    if ((__builtin_cpu_supports("sse4.2"))&&(__builtin_cpu_supports("popcnt"))) return (DOT_CPU_SSE42);
+    if (__builtin_cpu_supports("sse2")) return (DOT_CPU_SSE2);
+#elif defined(X86)
+    int r[4], n, sse2, sse42;
+    __cpuid(r,0);
+    n = r[0];
+    __cpuid(r,1);
+    sse2 = (r[3] & (1<<26))? 1:0;
+    sse42 = ((r[2] & (1<<20))&&(r[2] & (1<<23)))? 1:0;     // (& POPCNT)
+#if defined(X86_AVX2)
+    // AVX needs the OS to save the YMM registers (OSXSAVE, & XCR0 bits 1-2)
+    if ((sse42)&&(n >= 7)&&(r[2] & (1<<27))&&(r[2] & (1<<28))&&((_xgetbv(0) & 6) == 6)) {
+        __cpuidex(r,7,0);
+        if (r[1] & (1<<5)) return (DOT_CPU_AVX2);
+    }
+#else
+    (void)n;
+#endif
+#if defined(X86_POPCNT)
+    if (sse42) return (DOT_CPU_SSE42);
+#else
+    (void)sse42;
+#endif
+    if (sse2) return (DOT_CPU_SSE2);
+#endif
+    return (DOT_CPU_SCALAR);
+}
+
+int DotCodeCpu (void)
+{
+    static const char *names[] = { "scalar", "sse2", "sse4.2", "avx2" };
+    long level = AtomicLoad(&cpulevel);
+    const char *cap;
+    int i;
+
+    if (level < 0) {
+        level = CpuSupports();
+        if ((cap = getenv("DOTCODE_CPU"))) {
+            for (i=0; i<=DOT_CPU_AVX2; i++)
+                if ((!strcmp(cap,names[i]))&&(i < level)) level = i;
+        }
+        AtomicStore(&cpulevel,level);   // (racing threads all store the same)
+    }
+    return ((int)level);
+}
+
+/* ======================================================================= */
+/* *******************      LANED R-S ENCODING      ********************* */
+/* ======================================================================= */
+/*-------------------------------------------------------------------------*/
+/*  "EncodeBlock(w,nd,nc,pitch,c)" R-S encodes one interleaved block of    */
+/*  all the lanes, word "i" of which starts at "w[i*pitch]", by generator  */
+/*  "c" (the check words end up negated, exactly as rsencode() stores them)*/
+/*-------------------------------------------------------------------------*/
+typedef void (*blockfn) (unsigned short *w, int nd, int nc, int pitch, const unsigned char *c);
+
+static void EncodeBlock (unsigned short *w, int nd, int nc, int pitch, const unsigned char *c)
+{
+    int i, j, s;
+    unsigned short r[GF][RSLANES], k;
+
+    memset(r,0,sizeof(r));
+    for (i=0; i<nd; i++) {
+        for (s=0; s<RSLANES; s++) {
+            k = (w[i*pitch + s] + r[0][s]) % GF;
+            for (j=0; j<nc-1; j++) r[j][s] = (GF*GF + r[j+1][s] - c[j+1] * k) % GF;
+            r[nc-1][s] = (GF*GF - c[nc] * k) % GF;
+        }
+    }
+    for (j=0; j<nc; j++)
+        for (s=0; s<RSLANES; s++) w[(nd+j)*pitch + s] = (GF - r[j][s]) % GF;
+}
+
+#if defined(X86_AVX2)
+
+#define MOD256(x) _mm256_sub_epi16(x,_mm256_mullo_epi16(_mm256_mulhi_epu16(x,recip),gf))
+
+TARGET("avx2")
+static void EncodeBlockAvx2 (unsigned short *w, int nd, int nc, int pitch, const unsigned char *c)
+{
+    __m256i r[GF], k, x;
+    const __m256i gf = _mm256_set1_epi16(GF), sq = _mm256_set1_epi16(GF*GF), recip = _mm256_set1_epi16(GF_RECIP);
+    int i, j;
+
+    for (j=0; j<nc; j++) r[j] = _mm256_setzero_si256();
+    for (i=0; i<nd; i++) {
+        x = _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(w + i*pitch)),r[0]);
+        k = MOD256(x);
+        for (j=0; j<nc-1; j++) {
+            x = _mm256_sub_epi16(_mm256_add_epi16(r[j+1],sq),_mm256_mullo_epi16(_mm256_set1_epi16(c[j+1]),k));
+            r[j] = MOD256(x);
+        }
+        x = _mm256_sub_epi16(sq,_mm256_mullo_epi16(_mm256_set1_epi16(c[nc]),k));
+        r[nc-1] = MOD256(x);
+    }
+    for (j=0; j<nc; j++) {
+        x = _mm256_sub_epi16(gf,r[j]);
+        _mm256_storeu_si256((__m256i*)(w + (nd+j)*pitch),MOD256(x));
+    }
+}
+
+#endif
+#if defined(X86)
+
+#define MOD128(x) _mm_sub_epi16(x,_mm_mullo_epi16(_mm_mulhi_epu16(x,recip),gf))
+
+TARGET("sse2")
+static void EncodeHalf (unsigned short *w, int nd, int nc, int pitch, const unsigned char *c)
+{
+    __m128i r[GF], k, x;
+    const __m128i gf = _mm_set1_epi16(GF), sq = _mm_set1_epi16(GF*GF), recip = _mm_set1_epi16(GF_RECIP);
+    int i, j;
+
+    for (j=0; j<nc; j++) r[j] = _mm_setzero_si128();
+    for (i=0; i<nd; i++) {
+        x = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(w + i*pitch)),r[0]);
+        k = MOD128(x);
+        for (j=0; j<nc-1; j++) {
+            x = _mm_sub_epi16(_mm_add_epi16(r[j+1],sq),_mm_mullo_epi16(_mm_set1_epi16(c[j+1]),k));
+            r[j] = MOD128(x);
+        }
+        x = _mm_sub_epi16(sq,_mm_mullo_epi16(_mm_set1_epi16(c[nc]),k));
+        r[nc-1] = MOD128(x);
+    }
+    for (j=0; j<nc; j++) {
+        x = _mm_sub_epi16(gf,r[j]);
+        _mm_storeu_si128((__m128i*)(w + (nd+j)*pitch),MOD128(x));
+    }
+}
+
+static void EncodeBlockSse2 (unsigned short *w, int nd, int nc, int pitch, const unsigned char *c)
+{
+    int s;
+    for (s=0; s<RSLANES; s+=8) EncodeHalf(w+s,nd,nc,pitch,c);
+}
+
+#endif
+
+void RsEncodeLanes (unsigned short *w, int nd, int nc)
+{
+    int nw = nd+nc, step = (nw+GF-2)/(GF-1), start;
+    blockfn block = EncodeBlock;
+
+#if defined(X86_AVX2)
+    if (DotCodeCpu() >= DOT_CPU_AVX2) block = EncodeBlockAvx2;
+    else
+#endif
+#if defined(X86)
+    if (DotCodeCpu() >= DOT_CPU_SSE2) block = EncodeBlockSse2;
+#endif
+    // the same interleaved blocks as rsencode(), each "step"th word
+    for (start=0; start<step; start++) {
+        int ND = (nd-start+step-1)/step, NW = (nw-start+step-1)/step;
+        block(w + start*RSLANES,ND,NW-ND,step*RSLANES,GenPoly(NW-ND));
+    }
+}
+
+/* ======================================================================= */
+/* ******************      SCORING NEIGHBOUR TESTS      ****************** */
+/* ======================================================================= */
+#define ROWWORDS 290    /* 64 dot words in a row (18 thousand dots), & 2 spare */
+
+/*-------------------------------------------------------------------------*/
+/*  "RowBits(v,y,r,n)" sets "r[1]" thru "r[n]" to the bits of row "y" (0s  */
+/*  off the symbol), "r[0]" & "r[n+1]" being 0 margins                     */
+/*-------------------------------------------------------------------------*/
+static void RowBits (const dotview *v, int y, u64 *r, int n)
+{
+    static const unsigned char rev[16] = { 0,8,4,12,2,10,6,14,1,9,5,13,3,11,7,15 };
+    const unsigned char *b;
+    int k, x;
+
+    memset(r,0,sizeof(u64) * (n+2));
+    if ((y < 0)||(y >= v->rows)) return;
+    if (!v->layout) {   // (MSB first, so each byte is reversed)
+        b = v->bits + y * v->line;
+        for (k=0; k<((v->cols+7)>>3); k++) {
+            if (b[k]) r[1 + (k>>3)] |= (u64)((rev[b[k] & 0xf] << 4) | rev[b[k] >> 4]) << ((k&7)<<3);
+        }
+    }
+    else {
+        for (x=y&1; x<v->cols; x+=2) if (Printed(v,x,y)) r[1 + (x>>6)] |= (u64)1 << (x&63);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "CrossRow(c,u,d,u2,d2,n,live,last)" counts, in the row of bits "c"     */
+/*  ("u" & "d" those above & below, "u2" & "d2" two rows away), the dots   */
+/*  flagged by "live" (& by "last", in the last word) with no printed      */
+/*  diagonal neighbours & either unprinted or with no printed neighbours   */
+/*  two away, either                                                       */
+/*-------------------------------------------------------------------------*/
+#define SHL(r,i,k) (((r)[i] << (k)) | ((r)[(i)-1] >> (64-(k))))
+#define SHR(r,i,k) (((r)[i] >> (k)) | ((r)[(i)+1] << (64-(k))))
+
+#define CROSSROW(name,popcount) \
+static int name (const u64 *c, const u64 *u, const u64 *d, const u64 *u2, const u64 *d2, int n, u64 live, u64 last) \
+{ \
+    int i, sum = 0; \
+    u64 diag, away, hit; \
+    for (i=1; i<=n; i++) { \
+        diag = SHL(u,i,1) | SHR(u,i,1) | SHL(d,i,1) | SHR(d,i,1); \
+        away = SHL(c,i,2) | SHR(c,i,2) | u2[i] | d2[i]; \
+        hit = ~diag & (~c[i] | ~away) & ((i == n)? last : live); \
+        sum += popcount(hit); \
+    } \
+    return (sum); \
+}
+
+static int PopCount (u64 x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return ((int)((x * 0x0101010101010101ULL) >> 56));
+}
+
+typedef int (*crossfn) (const u64 *c, const u64 *u, const u64 *d, const u64 *u2, const u64 *d2, int n, u64 live, u64 last);
+
+CROSSROW(CrossRow,PopCount)
+#if defined(X86_POPCNT)
+TARGET("popcnt")
+CROSSROW(CrossRowPopcnt,POPCNT)
+#endif
+
+int CrossCountRows (const dotview *v, int y0, int y1)
+{
+    u64 rows[5][ROWWORDS], live, last;
+    int y, n = (v->cols + 63) >> 6, sum = 0;
+    crossfn cross = CrossRow;
+
+    if (n+2 > ROWWORDS) return (-1);
+#if defined(X86_POPCNT)
+    if (DotCodeCpu() >= DOT_CPU_SSE42) cross = CrossRowPopcnt;
+#endif
+    // a window of 5 rows, row "y" in rows[(y+5) % 5]
+    for (y=y0-2; y<y0+2; y++) RowBits(v,y,rows[(y+5) % 5],n);
+    for (y=y0; y<y1; y++) {
+        RowBits(v,y+2,rows[(y+2) % 5],n);
+        live = (y & 1)? 0xaaaaaaaaaaaaaaaaULL : 0x5555555555555555ULL;    // where x+y is even
+        last = ((v->cols & 63)? (((u64)1 << (v->cols & 63)) - 1) : ~(u64)0) & live;
+        sum += cross(rows[y % 5],rows[(y+4) % 5],rows[(y+1) % 5],rows[(y+3) % 5],rows[(y+2) % 5],n,live,last);
+    }
+    return (sum);
+}
+
+int CrossCount (const dotview *v)
+{
+    return (CrossCountRows(v,0,v->rows));
+}
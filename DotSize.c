@@ -0,0 +1,191 @@
+/* ======================================================================= */
+/**  "DotSize.c" -- symbol sizing & capacity queries, without encoding    **/
+/* ======================================================================= */
+
+// A message's size depends only on its count of data codewords, so that is
+//  found once (DotCodeWords()) & then sized for any number of height/width
+//  requests (DotCodeFit()) by the very rules DotCodeEncode() applies.  The
+//  other way round, the data codewords a symbol holds depend only on its #
+//  of dot positions, (rows*cols)/2, so its capacity is a simple formula, &
+//  DotCodeSizes() lists every legal size in order of capacity, &
+//  DotCodeOptimize() searches them for the best by a goal.
+//
+// The spec fixes the check words at a third of the codewords (plus 2), so
+//  an ECC level can't trade them off within a symbol; instead, each level
+//  over 0 sizes the symbol for a quarter more data words, the extra padded
+//  out, & so a quarter more check words protect the same message.
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+
+#define MINDIM 5    /* the least symbol height or width */
+
+static int CountWords (inputs *in, int literal)
+{
+    tokens tk;
+    unsigned char *CW;
+    int nd = -1;
+    if (Tokenize(&tk,MSG,LEN,literal)) return (-1);
+    if ((CW = (unsigned char*)DotAlloc(sizeof(unsigned char) * (tk.n<<4) + 4))) {
+        nd = EncodeTokens(&tk,CW);
+        DotFree(CW);
+    }
+    FreeTokens(&tk);
+    return (nd);
+}
+
+int DotCodeWords (inputs *in, int literal)
+{
+    return (CountWords(in,literal != 0));
+}
+
+int DotCodeWordsOptions (inputs *in, const options *opt)
+{
+    return (CountWords(in,MessageMode(opt)));
+}
+
+int DotCodeFit (int nd, int hgt, int wid, int *rows, int *cols)
+{
+    output out;
+    if (nd < 0) return (-1);
+    memset(&out,0,sizeof(output));
+    if (SymbolSize(nd,hgt,wid,&out) < 0) return (-1);
+    if (rows) *rows = out.rows;
+    if (cols) *cols = out.cols;
+    return (DotCodeCapacity(out.rows,out.cols));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "DotCodeCapacity(rows,cols)": SymbolSize() accepts "nd" data words in  */
+/*  "dots" positions while (nd + nd/2+3)*9 + 2 <= dots, & so at most       */
+/*  (2k+1)/3 of them, "k" being (dots-2)/9 - 3 (nor more than SymbolWords()*/
+/*  pads them out to)                                                      */
+/*-------------------------------------------------------------------------*/
+int DotCodeCapacity (int rows, int cols)
+{
+    output out;
+    int dots = (rows * cols)>>1, k, nd, ND, NC;
+
+    if ((rows < MINDIM)||(cols < MINDIM)||(!((rows + cols) & 1))) return (-1);
+    if (dots / 9 >= MAXWD) return (-1);
+    if ((k = (dots-2)/9 - 3) < 0) return (-1);    // (too small for the checks)
+    nd = (2*k + 1) / 3;
+    out.rows = rows;
+    out.cols = cols;
+    SymbolWords(&out,&ND,&NC);
+    return ((nd < ND)? nd : ND);
+}
+
+int DotCodeEccWords (int nd, int ecc)
+{
+    if ((nd < 0)||(ecc < 0)||(ecc >= DOT_ECC_LEVELS)) return (-1);
+    return (nd + (nd * ecc + 3) / 4);
+}
+
+int DotCodeEccCapacity (int rows, int cols, int ecc)
+{
+    int k = DotCodeCapacity(rows,cols), nd;
+    if ((k < 0)||(ecc < 0)||(ecc >= DOT_ECC_LEVELS)) return (-1);
+    // the most "nd" whose DotCodeEccWords() still fit, from near below
+    for (nd = (k * 4) / (4 + ecc); DotCodeEccWords(nd+1,ecc) <= k; nd++);
+    return (nd);
+}
+
+static int BySize (const void *a, const void *b)
+{
+    const dotsize *p = (const dotsize*)a, *q = (const dotsize*)b;
+    if (p->words != q->words) return (p->words - q->words);
+    if (p->rows * p->cols != q->rows * q->cols) return (p->rows * p->cols - q->rows * q->cols);
+    return (p->rows - q->rows);
+}
+
+int DotCodeSizes (int maxhgt, int maxwid, dotsize *sizes)
+{
+    int r, c, k, n = 0;
+    for (r=MINDIM; r<=maxhgt; r++) {
+        for (c=MINDIM + (r & 1); c<=maxwid; c+=2) {   // (rows+cols odd)
+            if ((k = DotCodeCapacity(r,c)) < 1) continue;
+            if (sizes) {
+                sizes[n].rows = r;
+                sizes[n].cols = c;
+                sizes[n].words = k;
+            }
+            n++;
+        }
+    }
+    if (sizes) qsort(sizes,n,sizeof(dotsize),BySize);
+    return (n);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Better(r,c,br,bc,g)" is 1 if "r" x "c" meets goal "g" better than the */
+/*  best so far, "br" x "bc" (none if "br" < 0); "Skew()" is how far a     */
+/*  size's aspect is from that wanted (as a log, so taller & wider count   */
+/*  alike)                                                                 */
+/*-------------------------------------------------------------------------*/
+static double Skew (int r, int c, const sizegoal *g)
+{
+    double k = log(((double)r * g->wid) / ((double)c * g->hgt));
+    return ((k < 0)? -k : k);
+}
+
+static int Better (int r, int c, int br, int bc, const sizegoal *g)
+{
+    double s, t;
+    if (br < 0) return (1);
+    switch (g->goal) {
+        case DOT_SIZE_WIDTH:
+            if (c != bc) return (c < bc);
+            break;
+        case DOT_SIZE_HEIGHT:
+            if (r != br) return (r < br);
+            break;
+        case DOT_SIZE_ASPECT:
+            s = Skew(r,c,g);
+            t = Skew(br,bc,g);
+            if (s != t) return (s < t);
+            break;
+    }
+    if (r * c != br * bc) return (r * c < br * bc);
+    return (abs(r - c) < abs(br - bc));
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "DotCodeOptimize(nd,g,rows,cols)": each height "r" is tried with the   */
+/*  fewest columns holding "nd" (from the dots SymbolSize() needs, up to   */
+/*  the capacity formula), unless 2 fewer rows hold it in as many columns  */
+/*  ("was", by parity); more rows or columns than that only add dots       */
+/*-------------------------------------------------------------------------*/
+int DotCodeOptimize (int nd, const sizegoal *g, int *rows, int *cols)
+{
+    int r, c, k, maxhgt, maxwid, need, br = -1, bc = -1, best = -1, was[2] = {0,0};
+
+    if ((nd < 0)||(g->goal < DOT_SIZE_DOTS)||(g->goal > DOT_SIZE_ASPECT)) return (-1);
+    if ((g->goal == DOT_SIZE_ASPECT)&&((g->hgt < 1)||(g->wid < 1))) return (-1);
+    need = (2 + 9 * (nd + (nd>>1) + 3)) << 1;
+    maxhgt = need / MINDIM + 2;
+    if ((g->maxhgt > 0)&&(g->maxhgt < maxhgt)) maxhgt = g->maxhgt;
+    maxwid = (g->maxwid > 0)? g->maxwid : need;
+
+    for (r=MINDIM; r<=maxhgt; r++) {
+        c = (need + r-1) / r;
+        if (c < MINDIM) c = MINDIM;
+        if (!((r + c) & 1)) c++;
+        while ((c <= maxwid)&&((k = DotCodeCapacity(r,c)) >= 0)&&(k < nd)) c += 2;
+        if ((c > maxwid)||(k < 0)||(c == was[r & 1])) continue;
+        was[r & 1] = c;
+        if (Better(r,c,br,bc,g)) {
+            br = r;
+            bc = c;
+            best = k;
+        }
+    }
+    if (best < 0) return (-1);
+    if (rows) *rows = br;
+    if (cols) *cols = bc;
+    return (best);
+}
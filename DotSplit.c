@@ -0,0 +1,233 @@
+/* ======================================================================= */
+/**  "DotSplit.c" -- splitting long messages into FNC3-linked symbol sets **/
+/* ======================================================================= */
+
+// DotCodeEncodeSet() partitions a message too long for the print area into
+//  a sequence of symbols, each ending in FNC3 (but the last) to link it to
+//  the next.  Each piece is one that fits, found by a binary search over
+//  the legal split points (never inside a "#x" sequence or an ECI), after
+//  which the pieces are masked & filled concurrently, each worker thread
+//  keeping its own placement map.  Fitting isn't monotonic in a piece's
+//  length ("#x" sequences, mode switches & the FNC3 ending a piece can each
+//  make a longer piece take fewer codewords), so the search only promises
+//  a piece that fits with the next legal end after it failing, not the
+//  longest: a set may have a symbol more than the fewest possible.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define UCHAR unsigned char
+#define TWIX(a,b,c) (((a)<=(c))&&((c)<=(b)))
+#define DIGIT(c) TWIX('0','9',(c))
+
+typedef struct {
+    inputs *in;
+    options *opt;
+    int maxhgt, maxwid;
+    UCHAR *split;           // split[i] non-zero if a piece may end before byte i
+    UCHAR *msg, *CW;        // a piece of the message & its codewords
+} splitter;
+
+/*-------------------------------------------------------------------------*/
+/*  "Piece(sp,start,end)" stages bytes "start" thru "end-1" (#-escaped, &  */
+/*  with an FNC3 unless it ends the message) returning the staged length   */
+/*-------------------------------------------------------------------------*/
+static int Piece (splitter *sp, UCHAR *msg, int start, int end)
+{
+    int i, n = 0;
+    if (sp->opt->literal) {
+        for (i=start; i<end; i++) {
+            if ((msg[n++] = sp->in->msg[i]) == '#') msg[n++] = '#';
+        }
+    }
+    else {
+        memcpy(msg,sp->in->msg+start,end-start);
+        n = end-start;
+    }
+    if (end < sp->in->msglen) {
+        msg[n++] = '#';
+        msg[n++] = '3';
+    }
+    return (n);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Fit(sp,start,end,out)" sizes that piece into "out", returning its     */
+/*  bitmap size, or -1 if it won't fit within the print area               */
+/*-------------------------------------------------------------------------*/
+static int Fit (splitter *sp, int start, int end, output *out)
+{
+    int n = Piece(sp,sp->msg,start,end), nd, size;
+    if ((nd = FindDataWords(sp->msg,n,sp->CW,0)) < 0) return (-1);
+    nd = DotCodeEccWords(nd,sp->opt->ecc);
+    SetLayout(out,sp->opt);
+    if (sp->maxhgt > 0) size = SymbolSize(nd,sp->maxhgt,0,out);
+    else if (sp->maxwid > 0) size = SymbolSize(nd,0,sp->maxwid,out);
+    else size = SymbolSize(nd,0,0,out);
+    if ((size >= 0)&&(sp->maxwid > 0)&&(NCOL > sp->maxwid)) size = -1;
+    return (size);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "Partition(sp,outs,ends,maxsyms)" finds a piece that fits (bisecting,  */
+/*  so not always the longest) from each start in turn, returning the # of */
+/*  pieces (or -1)                                                         */
+/*-------------------------------------------------------------------------*/
+static int Partition (splitter *sp, output *outs, int *ends, int maxsyms)
+{
+    int start = 0, end, lo, hi, mid, nsyms = 0, len = sp->in->msglen;
+    output trial;
+
+    do {
+        if (nsyms >= maxsyms) return (-1);
+        if (Fit(sp,start,len,outs+nsyms) >= 0) end = len;
+        else {
+            // bisect between a fitting end "lo" & a failing end "hi", until
+            // they're adjacent split points (fitting isn't monotonic, so
+            // a longer piece past "hi" might still fit)
+            for (lo=start+1; (lo<len)&&(!sp->split[lo]); lo++);
+            if ((lo >= len)||(Fit(sp,start,lo,outs+nsyms) < 0)) return (-1);
+            hi = len;
+            trial = outs[nsyms];
+            while (1) {
+                for (mid=(lo+hi)>>1; (mid>lo)&&(!sp->split[mid]); mid--);
+                if (mid == lo) {
+                    for (mid=((lo+hi)>>1)+1; (mid<hi)&&(!sp->split[mid]); mid++);
+                    if (mid == hi) break;
+                }
+                if (Fit(sp,start,mid,&trial) >= 0) {
+                    lo = mid;
+                    outs[nsyms].rows = trial.rows;
+                    outs[nsyms].cols = trial.cols;
+                }
+                else hi = mid;
+            }
+            end = lo;
+        }
+        if (ends) ends[nsyms] = end;
+        nsyms++;
+        start = end;
+    }
+    while (start < len);
+    return (nsyms);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "FillPieces()" encodes every "nthreads"th piece, from piece "first"    */
+/*-------------------------------------------------------------------------*/
+typedef struct {
+    splitter *sp;
+    const int *ends;
+    output *outs;
+    int first, nsyms, nthreads, fail;
+    dcthread thread;
+} setworker;
+
+static void FillPieces (void *arg)
+{
+    setworker *wk = (setworker*)arg;
+    splitter *sp = wk->sp;
+    UCHAR *msg = (UCHAR*)malloc(sizeof(UCHAR) * ((sp->in->msglen<<1) + 4));
+    UCHAR *CW = (UCHAR*)malloc(sizeof(UCHAR) * (((sp->in->msglen<<1) + 4)<<4) + 4);
+    dotmap map;
+    int i, n, nd;
+
+    memset(&map,0,sizeof(dotmap));
+    if ((!msg)||(!CW)) wk->fail = 1;
+    for (i=wk->first; (!wk->fail)&&(i<wk->nsyms); i+=wk->nthreads) {
+        n = Piece(sp,msg,(i)? wk->ends[i-1]:0,wk->ends[i]);
+        nd = FindDataWords(msg,n,CW,0);
+        if ((nd < 0)||(EncodeSymbol(&map,wk->outs+i,CW,nd,sp->opt->topmsk,0,sp->opt->fast))) wk->fail = 1;
+    }
+    FreeDotMap(&map);
+    free(msg);
+    free(CW);
+}
+
+/* ======================================================================= */
+/* *******************      SYMBOL SET ENCODING      ********************* */
+/* ======================================================================= */
+
+int DotCodeEncodeSet (inputs *in, int maxhgt, int maxwid, output *outs, int *ends, int maxsyms,
+                      options *opt, int threads, int fill)
+{
+    splitter sp;
+    int i, nsyms = -1, *cuts;
+
+    // First, if not "literal", check that all #-sequences terminate legally
+    if (opt->gs1) return (-1);
+    if (!opt->literal) {
+        for (i=0; i<in->msglen; i++) {
+            if (in->msg[i] == '#') {
+                if (++i >= in->msglen) return (-1);
+                if ((in->msg[i] != '#')&&((in->msg[i] < '0')||(in->msg[i] > '3'))) return (-1);
+            }
+        }
+    }
+    if (maxsyms < 1) return (-1);
+
+    memset(&sp,0,sizeof(splitter));
+    sp.in = in;
+    sp.opt = opt;
+    sp.maxhgt = maxhgt;
+    sp.maxwid = maxwid;
+    sp.split = (UCHAR*)malloc(sizeof(UCHAR) * (in->msglen + 1));
+    sp.msg = (UCHAR*)malloc(sizeof(UCHAR) * ((in->msglen<<1) + 4));
+    sp.CW = (UCHAR*)malloc(sizeof(UCHAR) * (((in->msglen<<1) + 4)<<4) + 4);
+    cuts = (ends)? ends : (int*)malloc(sizeof(int) * maxsyms);
+
+    if ((sp.split)&&(sp.msg)&&(sp.CW)&&(cuts)) {
+        // mark where pieces may end: never within "#x", nor "#2" & its ECI digits
+        memset(sp.split,1,in->msglen + 1);
+        for (i=0; (!opt->literal)&&(i<in->msglen); i++) {
+            if (in->msg[i] == '#') {
+                int n = 2, k;
+                if (in->msg[i+1] == '2') {
+                    for (k=i+2; (k<in->msglen)&&(k<i+8)&&(DIGIT(in->msg[k])); k++);
+                    if (k == i+8) n = 8;
+                }
+                for (k=1; k<n; k++) sp.split[i+k] = 0;
+                i += n-1;
+            }
+        }
+
+        nsyms = Partition(&sp,outs,cuts,maxsyms);
+
+        if ((fill)&&(nsyms > 0)) {
+            setworker *wks;
+            int started;
+            if (threads > nsyms) threads = nsyms;
+            if (threads < 1) threads = 1;
+            wks = (setworker*)calloc(threads,sizeof(setworker));
+            if (!wks) nsyms = -1;
+            else {
+                for (i=0; i<threads; i++) {
+                    wks[i].sp = &sp;
+                    wks[i].ends = cuts;
+                    wks[i].outs = outs;
+                    wks[i].first = i;
+                    wks[i].nsyms = nsyms;
+                    wks[i].nthreads = threads;
+                }
+                // the calling thread takes the first share itself
+                for (started=1; started<threads; started++)
+                    if (ThreadStart(&wks[started].thread,FillPieces,wks+started)) break;
+                for (i=started; i<threads; i++) FillPieces(wks+i);
+                FillPieces(wks);
+                for (i=1; i<started; i++) ThreadJoin(wks[i].thread);
+                for (i=0; i<threads; i++) if (wks[i].fail) nsyms = -1;
+                free(wks);
+            }
+        }
+    }
+
+    if (cuts != ends) free(cuts);
+    free(sp.split);
+    free(sp.msg);
+    free(sp.CW);
+    return (nsyms);
+}
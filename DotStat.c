@@ -0,0 +1,64 @@
+/* ======================================================================= */
+/**  "DotStat.c" -- process-wide mask selection counters (telemetry)      **/
+/* ======================================================================= */
+
+// FillSymbol() tallies each symbol's mask selection locally & then adds it
+//  to these counters in a handful of atomic adds, so any number of encoding
+//  threads share them cheaply.  The counters are simply a "dotstats" laid
+//  out as an array of longs, which DotCodeStats() copies out (& optionally
+//  subtracts back, so that counts landing meanwhile aren't lost).
+
+#include <stddef.h>
+#include <string.h>
+
+#include "DotEncod.h"
+#include "DotPriv.h"
+#include "DotThrd.h"
+
+#define NSTATS (sizeof(dotstats) / sizeof(long))
+
+static volatile long stats[NSTATS];
+
+#define STAT(f) (stats + (offsetof(dotstats,f) / sizeof(long)))
+
+/*-------------------------------------------------------------------------*/
+/*  "CountFill(sel)" adds one symbol's mask selection to the counters      */
+/*-------------------------------------------------------------------------*/
+void CountFill (const maskpick *sel)
+{
+    int k;
+    AtomicAdd(STAT(symbols),1);
+    AtomicAdd(STAT(winners) + (sel->mask & 7),1);
+    if (sel->scored == 0) {
+        AtomicAdd(STAT(dictated),1);
+        return;
+    }
+    if (sel->fast) AtomicAdd(STAT(fast),1);
+    if (sel->bypass) AtomicAdd(STAT(bypass),1);
+    AtomicAdd(STAT(scored),sel->scored);
+    AtomicAdd(STAT(candidates) + ((sel->scored < DOT_CANDIDATES)? sel->scored : DOT_CANDIDATES-1),1);
+    if (sel->unlit) AtomicAdd(STAT(unlit),sel->unlit);
+    if (sel->sampled) {
+        AtomicAdd(STAT(sampled),1);
+        AtomicAdd(STAT(sampleerr),sel->error);
+    }
+
+    // margins binned by powers of 2: [0] none, [1] 1, [2] 2-3, [3] 4-7...
+    if (sel->margin <= 0) k = 0;
+    else for (k=1; (k < DOT_MARGINS-1)&&((sel->margin >> k) > 0); k++);
+    AtomicAdd(STAT(margins) + k,1);
+}
+
+/* ======================================================================= */
+/* *********************      SNAPSHOT API      ************************* */
+/* ======================================================================= */
+
+void DotCodeStats (dotstats *s, int reset)
+{
+    long *to = (long*)s;
+    unsigned int i;
+    for (i=0; i<NSTATS; i++) {
+        to[i] = AtomicLoad(stats+i);
+        if ((reset)&&(to[i])) AtomicAdd(stats+i,-to[i]);
+    }
+}
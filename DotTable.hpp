@@ -0,0 +1,175 @@
+/* ======================================================================= */
+/**  "DotTable.hpp" -- compile-time DotCode encoder tables  (C++14 & up)  **/
+/* ======================================================================= */
+
+// The C++ build of the encoder (DotEncod.cpp) includes this header to have
+//  the Galois field arithmetic, the R-S generator polynomials, the mask ramps
+//  & the 5-of-9 character patterns generated by the compiler rather than at
+//  run time.  Every table is checked by "static_assert" below, so a build
+//  with a broken table can't link, and none costs anything at startup.
+
+#ifndef DOTTABLE_HPP
+#define DOTTABLE_HPP
+
+namespace dotcode {
+namespace tables {
+
+constexpr int GFSIZE = 113; // Size of the Galois field
+constexpr int GFROOT = 3;   // Prime Modulus (a primitive root) of the field
+constexpr int MAXNC = GFSIZE-2;  // Max # of check words in one R-S block
+constexpr int NPATS = 113;  // 5-of-9 patterns for the values 0 thru 112
+constexpr int NRAMP = 5000; // mask ramp length, = max # of Codewords
+
+template <typename T, int N> struct table {
+    T v[N];
+    constexpr const T &operator[] (int i) const { return v[i]; }
+};
+template <typename T, int N, int M> struct table2 {
+    T v[N][M];
+    constexpr const T *operator[] (int i) const { return v[i]; }
+};
+
+/*-------------------------------------------------------------------------*/
+/*  The antilogs ("alg[i]" = 3^i) & logs of the field, & its products      */
+/*-------------------------------------------------------------------------*/
+constexpr table<int,GFSIZE> MakeAntilogs ()
+{
+    table<int,GFSIZE> t = {};
+    t.v[0] = 1;
+    for (int i=1; i<GFSIZE; i++) t.v[i] = (GFROOT * t.v[i-1]) % GFSIZE;
+    return t;
+}
+constexpr table<int,GFSIZE> alg = MakeAntilogs();
+
+constexpr table<int,GFSIZE> MakeLogs ()
+{
+    table<int,GFSIZE> t = {};
+    for (int i=0; i<GFSIZE-1; i++) t.v[alg[i]] = i;
+    return t;
+}
+constexpr table<int,GFSIZE> lg = MakeLogs();
+
+constexpr table2<unsigned char,GFSIZE,GFSIZE> MakeProducts ()
+{
+    table2<unsigned char,GFSIZE,GFSIZE> t = {};
+    for (int a=0; a<GFSIZE; a++)
+        for (int b=0; b<GFSIZE; b++) t.v[a][b] = (unsigned char)((a * b) % GFSIZE);
+    return t;
+}
+constexpr table2<unsigned char,GFSIZE,GFSIZE> mul = MakeProducts();
+
+/*-------------------------------------------------------------------------*/
+/*  "gen[nc]" is the R-S generator polynomial of order "nc", highest       */
+/*  power first, whose roots are 3^1 thru 3^nc (as rsencode() computes)    */
+/*-------------------------------------------------------------------------*/
+constexpr table2<unsigned char,MAXNC+1,MAXNC+1> MakeGenerators ()
+{
+    table2<unsigned char,MAXNC+1,MAXNC+1> t = {};
+    for (int nc=0; nc<=MAXNC; nc++) {
+        int c[MAXNC+1] = {};
+        c[0] = 1;
+        for (int i=1; i<=nc; i++)
+            for (int j=nc; j>=1; j--) c[j] = (GFSIZE + c[j] - (alg[i] * c[j-1]) % GFSIZE) % GFSIZE;
+        for (int j=0; j<=nc; j++) t.v[nc][j] = (unsigned char)c[j];
+    }
+    return t;
+}
+constexpr table2<unsigned char,MAXNC+1,MAXNC+1> gen = MakeGenerators();
+
+/*-------------------------------------------------------------------------*/
+/*  "ramp[m][i]" is the mask "m" offset added to data word "i"             */
+/*-------------------------------------------------------------------------*/
+constexpr int maskstep[4] = { 0, 3, 7, 17 };
+
+constexpr table2<unsigned char,4,NRAMP> MakeRamps ()
+{
+    table2<unsigned char,4,NRAMP> t = {};
+    for (int m=0; m<4; m++)
+        for (int i=0,r=0; i<NRAMP; i++,r=(r+maskstep[m])%GFSIZE) t.v[m][i] = (unsigned char)r;
+    return t;
+}
+constexpr table2<unsigned char,4,NRAMP> ramp = MakeRamps();
+
+/*-------------------------------------------------------------------------*/
+/*  The character patterns: every 9-bit pattern of 5 dots, ordered by the  */
+/*  most on/off transitions & then by value, keeping the first 113         */
+/*-------------------------------------------------------------------------*/
+constexpr int Dots (int p)
+{
+    int n = 0;
+    for (; p; p>>=1) n += p & 1;
+    return n;
+}
+constexpr int Transitions (int p)
+{
+    int n = 0;
+    for (int b=0; b<8; b++) n += ((p>>b) ^ (p>>(b+1))) & 1;
+    return n;
+}
+
+constexpr table<int,NPATS> MakeCharPats ()
+{
+    table<int,NPATS> t = {};
+    int n = 0;
+    for (int tr=8; tr>=0; tr--)
+        for (int p=0; p<0x200; p++)
+            if ((Dots(p) == 5)&&(Transitions(p) == tr)&&(n < NPATS)) t.v[n++] = p;
+    return t;
+}
+constexpr table<int,NPATS> pats = MakeCharPats();
+
+/* ======================================================================= */
+/* ********************      COMPILE-TIME CHECKS      ******************** */
+/* ======================================================================= */
+constexpr bool LogsInvert ()
+{
+    for (int x=1; x<GFSIZE; x++) if ((alg[lg[x]] != x)||(lg[alg[x-1]] != x-1)) return false;
+    for (int i=1; i<GFSIZE-1; i++) if (alg[i] == 1) return false;    // 3 must be primitive
+    return true;
+}
+constexpr bool ProductsHold ()
+{
+    for (int a=1; a<GFSIZE; a++)
+        for (int b=1; b<GFSIZE; b++) if (mul[a][b] != alg[(lg[a] + lg[b]) % (GFSIZE-1)]) return false;
+    for (int a=0; a<GFSIZE; a++) if ((mul[a][0])||(mul[0][a])) return false;
+    return true;
+}
+constexpr bool RootsHold ()
+{
+    for (int nc=1; nc<=MAXNC; nc++) {
+        if (gen[nc][0] != 1) return false;
+        for (int i=1; i<=nc; i++) {     // Horner's rule at each root
+            int v = 0;
+            for (int j=0; j<=nc; j++) v = (v * alg[i] + gen[nc][j]) % GFSIZE;
+            if (v) return false;
+        }
+    }
+    return true;
+}
+constexpr bool RampsHold ()
+{
+    for (int m=0; m<4; m++)
+        for (int i=0; i<NRAMP; i++) if (ramp[m][i] != (i * maskstep[m]) % GFSIZE) return false;
+    return true;
+}
+constexpr bool PatsHold ()
+{
+    for (int i=0; i<NPATS; i++) {
+        if ((pats[i] >= 0x200)||(Dots(pats[i]) != 5)||(Transitions(pats[i]) < 3)) return false;
+        if ((i)&&(Transitions(pats[i]) == Transitions(pats[i-1]))&&(pats[i] <= pats[i-1])) return false;
+        if ((i)&&(Transitions(pats[i]) > Transitions(pats[i-1]))) return false;
+    }
+    return true;
+}
+
+static_assert(LogsInvert(), "GF(113) log & antilog tables must invert, with 3 primitive");
+static_assert(ProductsHold(), "GF(113) products must agree with the log tables");
+static_assert(RootsHold(), "every generator polynomial must vanish at 3^1 thru 3^nc");
+static_assert(RampsHold(), "mask ramps must be i * step (mod 113)");
+static_assert(PatsHold(), "character patterns must be distinct 5-of-9s, most transitions first");
+static_assert((pats[0] == 0x155)&&(pats[NPATS-1] == 0x1cc), "character patterns must span 0x155 thru 0x1cc");
+
+}   // namespace tables
+}   // namespace dotcode
+
+#endif
@@ -0,0 +1,210 @@
+/* ======================================================================= */
+/**    "DotThrd.c" -- portable threading shims for the DotCode library    **/
+/* ======================================================================= */
+
+#include <stdlib.h>
+
+#include "DotEncod.h"
+#include "DotThrd.h"
+
+#if defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#include <time.h>
+#endif
+
+/* ======================================================================= */
+/* ************************        THREADS        ************************ */
+/* ======================================================================= */
+typedef struct {
+    void (*fn)(void *);
+    void *arg;
+} trampoline;
+
+#if defined(_WIN32)
+static unsigned __stdcall ThreadEntry (void *p)
+#else
+static void *ThreadEntry (void *p)
+#endif
+{
+    trampoline t = *(trampoline*)p;
+    free(p);
+    t.fn(t.arg);
+    DotCodeThreadDone();    // (the per-thread state the library keeps)
+    return (0);
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "ThreadStart(*t,fn,arg)" runs "fn(arg)" on a new thread, returning 0   */
+/*-------------------------------------------------------------------------*/
+int ThreadStart (dcthread *t, void (*fn)(void *), void *arg)
+{
+    trampoline *p = (trampoline*)malloc(sizeof(trampoline));
+    if (!p) return (-1);
+    p->fn = fn;
+    p->arg = arg;
+#if defined(_WIN32)
+    *t = (HANDLE)_beginthreadex(NULL,0,ThreadEntry,p,0,NULL);
+    if (*t) return (0);
+#else
+    if (!pthread_create(t,NULL,ThreadEntry,p)) return (0);
+#endif
+    free(p);
+    return (-1);
+}
+
+void ThreadJoin (dcthread t)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(t,INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t,NULL);
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/*  "CpuCount()" returns the # of processors available (at least 1)        */
+/*-------------------------------------------------------------------------*/
+int CpuCount (void)
+{
+    long n;
+#if defined(_WIN32)
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    n = si.dwNumberOfProcessors;
+#else
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return ((n > 0)? (int)n:1);
+}
+
+/* ======================================================================= */
+/* ******************      MUTEXES & CONDITIONS      ********************* */
+/* ======================================================================= */
+#if defined(_WIN32)
+void MutexInit (dcmutex *m)   { InitializeCriticalSection(m); }
+void MutexLock (dcmutex *m)   { EnterCriticalSection(m); }
+void MutexUnlock (dcmutex *m) { LeaveCriticalSection(m); }
+void MutexFree (dcmutex *m)   { DeleteCriticalSection(m); }
+
+#if defined(WIN_CONDVAR)
+void CondInit (dccond *c)             { InitializeConditionVariable(c); }
+void CondWait (dccond *c, dcmutex *m) { SleepConditionVariableCS(c,m,INFINITE); }
+void CondWake (dccond *c)             { WakeAllConditionVariable(c); }
+void CondFree (dccond *c)             { (void)c; }
+#else
+/*-------------------------------------------------------------------------*/
+/*  Before Vista, a condition is an event & a count of waiters: CondWake() */
+/*  sets the event for those waiting then, & the last of them to wake      */
+/*  resets it (a later waiter, of the next generation, waits on for that)  */
+/*-------------------------------------------------------------------------*/
+void CondInit (dccond *c)
+{
+    InitializeCriticalSection(&c->lock);
+    c->event = CreateEvent(NULL,TRUE,FALSE,NULL);
+    c->waiters = c->release = 0;
+    c->gen = 0;
+}
+
+void CondWait (dccond *c, dcmutex *m)
+{
+    unsigned gen;
+    int woken;
+
+    EnterCriticalSection(&c->lock);
+    c->waiters++;
+    gen = c->gen;
+    LeaveCriticalSection(&c->lock);
+    LeaveCriticalSection(m);
+    do {
+        WaitForSingleObject(c->event,INFINITE);
+        EnterCriticalSection(&c->lock);
+        woken = (c->release > 0)&&(c->gen != gen);
+        if (woken) {
+            c->waiters--;
+            if (--c->release == 0) ResetEvent(c->event);
+        }
+        LeaveCriticalSection(&c->lock);
+        if (!woken) Sleep(0);   // (the event's still set for older waiters)
+    }
+    while (!woken);
+    EnterCriticalSection(m);
+}
+
+void CondWake (dccond *c)
+{
+    EnterCriticalSection(&c->lock);
+    if (c->waiters > 0) {
+        c->release = c->waiters;
+        c->gen++;
+        SetEvent(c->event);
+    }
+    LeaveCriticalSection(&c->lock);
+}
+
+void CondFree (dccond *c)
+{
+    CloseHandle(c->event);
+    DeleteCriticalSection(&c->lock);
+}
+#endif
+#else
+void MutexInit (dcmutex *m)   { pthread_mutex_init(m,NULL); }
+void MutexLock (dcmutex *m)   { pthread_mutex_lock(m); }
+void MutexUnlock (dcmutex *m) { pthread_mutex_unlock(m); }
+void MutexFree (dcmutex *m)   { pthread_mutex_destroy(m); }
+
+void CondInit (dccond *c)             { pthread_cond_init(c,NULL); }
+void CondWait (dccond *c, dcmutex *m) { pthread_cond_wait(c,m); }
+void CondWake (dccond *c)             { pthread_cond_broadcast(c); }
+void CondFree (dccond *c)             { pthread_cond_destroy(c); }
+#endif
+
+/* ======================================================================= */
+/* ***********************      ATOMICS & CLOCK      ********************* */
+/* ======================================================================= */
+#if defined(_WIN32)
+long AtomicLoad (volatile long *p)           { return (InterlockedCompareExchange(p,0,0)); }
+void AtomicStore (volatile long *p, long v)  { InterlockedExchange(p,v); }
+long AtomicAdd (volatile long *p, long v)    { return (InterlockedExchangeAdd(p,v) + v); }
+int  AtomicSwap (volatile long *p, long expect, long v) { return (InterlockedCompareExchange(p,v,expect) == expect); }
+
+long long ClockMs (void)
+{
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return ((long long)(t.QuadPart / f.QuadPart * 1000 + t.QuadPart % f.QuadPart * 1000 / f.QuadPart));
+}
+long long ClockNs (void)
+{
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return ((long long)((double)t.QuadPart * 1e9 / (double)f.QuadPart));
+}
+#else
+long AtomicLoad (volatile long *p)           { return (__atomic_load_n(p,__ATOMIC_SEQ_CST)); }
+void AtomicStore (volatile long *p, long v)  { __atomic_store_n(p,v,__ATOMIC_SEQ_CST); }
+long AtomicAdd (volatile long *p, long v)    { return (__atomic_add_fetch(p,v,__ATOMIC_SEQ_CST)); }
+int  AtomicSwap (volatile long *p, long expect, long v)
+{
+    return (__atomic_compare_exchange_n(p,&expect,v,0,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST));
+}
+
+long long ClockMs (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+long long ClockNs (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ((long long)ts.tv_sec * 1000000000 + ts.tv_nsec);
+}
+#endif
@@ -0,0 +1,78 @@
+/* ======================================================================= */
+/**    "DotThrd.h" -- portable threading shims for the DotCode library    **/
+/* ======================================================================= */
+
+#ifndef DOTTHRD_H
+#define DOTTHRD_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*-------------------------------------------------------------------------*/
+/******************   THREAD-LOCAL STORAGE & PRIMITIVES   ******************/
+/*-------------------------------------------------------------------------*/
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#if defined(_WIN32)&&defined(_WIN32_WINNT)&&(_WIN32_WINNT >= 0x0600)
+#define WIN_CONDVAR     /* (Vista's condition variables) */
+#endif
+
+#if defined(_WIN32)
+typedef HANDLE dcthread;
+typedef CRITICAL_SECTION dcmutex;
+#if defined(WIN_CONDVAR)
+typedef CONDITION_VARIABLE dccond;
+#else
+typedef struct {
+	CRITICAL_SECTION lock;	// guards the counts...
+	HANDLE event;			// ... & this manual-reset event, set while
+	int waiters, release;	// "release" of the "waiters" may yet wake
+	unsigned gen;			// the CondWake() generation
+} dccond;
+#endif
+#else
+typedef pthread_t dcthread;
+typedef pthread_mutex_t dcmutex;
+typedef pthread_cond_t dccond;
+#endif
+
+int  ThreadStart (dcthread *t, void (*fn)(void *), void *arg);  // 0 if started
+void ThreadJoin (dcthread t);
+int  CpuCount (void);
+
+void MutexInit (dcmutex *m);
+void MutexLock (dcmutex *m);
+void MutexUnlock (dcmutex *m);
+void MutexFree (dcmutex *m);
+
+void CondInit (dccond *c);
+void CondWait (dccond *c, dcmutex *m);
+void CondWake (dccond *c);      // wakes ALL waiters
+void CondFree (dccond *c);
+
+/*-------------------------------------------------------------------------*/
+/******************   ATOMICS (SEQUENTIALLY CONSISTENT) & CLOCK   **********/
+/*-------------------------------------------------------------------------*/
+long AtomicLoad (volatile long *p);
+void AtomicStore (volatile long *p, long v);
+long AtomicAdd (volatile long *p, long v);      // returns the new value
+int  AtomicSwap (volatile long *p, long expect, long v);   // non-0 if swapped
+long long ClockMs (void);       // monotonic milliseconds
+long long ClockNs (void);       // ... & nanoseconds (for timing)
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif